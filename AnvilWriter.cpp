@@ -1,7 +1,14 @@
 #include "AnvilWriter.h"
+#include "BlockMap.h"
+#include "LightEngine.h"
 #include "NBT.h"
+#include "SectionPack.h"
+#include "SectorAllocator.h"
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -9,167 +16,469 @@
 using namespace nbt;
 
 struct AnvilWriter::RegionFile {
-	std::string path;
-	FILE* fp;
-	std::vector<uint8_t> header; // 8KB header in memory
-	std::vector<uint8_t> sectors; // file content beyond header
-	// track used sectors (0 reserved for header)
-	std::vector<bool> used;
-	RegionFile(): fp(nullptr) {}
+	std::string path;      // file being written (the .tmp file in crash-safe mode)
+	std::string finalPath; // r.x.z.mca
+	int fd;
+	std::vector<uint8_t> header; // 8KB header in memory, written on checkpoint()/close()
+	SectorAllocator sectors; // sectors 0 and 1 reserved for header
+	unsigned long long lastUse; // writer clock at the last chunk, for LRU eviction
+	bool failed; // a write failed before the region was last evicted
+	RegionFile(): fd(-1), lastUse(0), failed(false) {}
 };
 
+static const size_t SECTOR_BYTES = 4096;
+static const size_t PAYLOAD_HEADER = 5; // big-endian length + compression type
+static const int MAX_CHUNK_SECTORS = 255; // sector count is a single byte of the location entry
+static const size_t DEFAULT_MAX_OPEN_REGIONS = 256; // well below the usual 1024 fd limit
+
+static const int32_t DATA_VERSION_1_16 = 2586; // 1.16.5; newer versions upgrade such chunks on load
+
+static_assert(COLUMN_SECTIONS == CHUNKS_PER_COLUMN_IN_FILE, "light is computed per Eden chunk");
+
+// Tag headers of the chunk NBT, encoded at compile time
+static constexpr auto HEADER_ROOT = tagHeader(TAG_Compound, "");
+static constexpr auto HEADER_LEVEL = tagHeader(TAG_Compound, "Level");
+static constexpr auto HEADER_XPOS = tagHeader(TAG_Int, "xPos");
+static constexpr auto HEADER_ZPOS = tagHeader(TAG_Int, "zPos");
+static constexpr auto HEADER_Y = tagHeader(TAG_Byte, "Y");
+static constexpr auto HEADER_BLOCKS = arrayHeader(TAG_Byte_Array, "Blocks", 4096);
+static constexpr auto HEADER_DATA = arrayHeader(TAG_Byte_Array, "Data", 2048);
+static constexpr auto HEADER_SKYLIGHT = arrayHeader(TAG_Byte_Array, "SkyLight", 2048);
+static constexpr auto HEADER_BLOCKLIGHT = arrayHeader(TAG_Byte_Array, "BlockLight", 2048);
+static constexpr auto HEADER_PALETTE = tagHeader(TAG_List, "Palette");
+static constexpr auto HEADER_BLOCKSTATES = tagHeader(TAG_Long_Array, "BlockStates");
+static constexpr auto HEADER_DATAVERSION = tagHeader(TAG_Int, "DataVersion");
+
+// The parts of a chunk that are the same in every chunk, encoded once; a chunk is these runs
+// with its own values in between
+struct ChunkSkeleton {
+	Buffer levelFields;   // LastUpdate .. Biomes, then the HeightMap header and length
+	Buffer sectionsStart; // empty Entities and TileEntities lists, then the Sections list header up to its length
+	Buffer paletteLevelFields; // 1.16: LastUpdate .. Biomes and the lists, up to the Sections length
+	uint8_t fullSkyLight[2048];
+	uint8_t noBlockLight[2048];
+	ChunkSkeleton() {
+		uint8_t plainsBiomes[256];
+		memset(plainsBiomes, 1, sizeof(plainsBiomes));
+		writeLong(levelFields, "LastUpdate", 0);
+		writeLong(levelFields, "InhabitedTime", 0);
+		writeByte(levelFields, "TerrainPopulated", 1);
+		writeByte(levelFields, "LightPopulated", 1);
+		writeByteArray(levelFields, "Biomes", plainsBiomes, sizeof(plainsBiomes)); // plains
+		writeTagHeader(levelFields, TAG_Int_Array, "HeightMap");
+		levelFields.writeI32(256);
+		beginList(sectionsStart, "Entities", TAG_Compound, 0);
+		beginList(sectionsStart, "TileEntities", TAG_Compound, 0);
+		writeTagHeader(sectionsStart, TAG_List, "Sections");
+		sectionsStart.writeU8((uint8_t)TAG_Compound);
+		memset(fullSkyLight, 0xFF, sizeof(fullSkyLight));
+		memset(noBlockLight, 0, sizeof(noBlockLight));
+
+		int32_t plainsBiomes3d[1024]; // 4x4x4 cells over the full 256 block height
+		for (int i = 0; i < 1024; i++) plainsBiomes3d[i] = 1;
+		writeLong(paletteLevelFields, "LastUpdate", 0);
+		writeLong(paletteLevelFields, "InhabitedTime", 0);
+		writeString(paletteLevelFields, "Status", "full");
+		writeByte(paletteLevelFields, "isLightOn", 1);
+		writeIntArray(paletteLevelFields, "Biomes", plainsBiomes3d, 1024);
+		paletteLevelFields.writeBytes(sectionsStart.data.data(), sectionsStart.data.size());
+	}
+};
+static const ChunkSkeleton skeleton;
+
+// Palette entries (compound payloads with Name and Properties) of all 4096 legacy states, encoded
+// on first use of the 1.16 format
+struct PaletteEntries {
+	Buffer bytes;
+	uint32_t offset[256 * 16 + 1];
+	PaletteEntries() {
+		for (int key = 0; key < 256 * 16; key++) {
+			offset[key] = (uint32_t)bytes.data.size();
+			const ModernBlockState& state = modernBlockState((uint8_t)(key >> 4), (uint8_t)(key & 0x0F));
+			writeString(bytes, "Name", state.name);
+			if (state.properties[0][0]) {
+				beginCompound(bytes, "Properties");
+				for (size_t p = 0; p < sizeof(state.properties) / sizeof(state.properties[0]) && state.properties[p][0]; p++) writeString(bytes, state.properties[p][0], state.properties[p][1]);
+				endCompound(bytes);
+			}
+			endCompoundPayload(bytes);
+		}
+		offset[256 * 16] = (uint32_t)bytes.data.size();
+	}
+};
+
+static const PaletteEntries& paletteEntries() {
+	static const PaletteEntries entries;
+	return entries;
+}
+
+bool parseChunkFormat(const char* text, ChunkFormat& out) {
+	if (strcmp(text, "1.12") == 0) out = CHUNK_FORMAT_1_12;
+	else if (strcmp(text, "1.16") == 0) out = CHUNK_FORMAT_1_16;
+	else return false;
+	return true;
+}
+
+const char* chunkFormatName(ChunkFormat format) {
+	switch (format) {
+	case CHUNK_FORMAT_1_16: return "1.16";
+	default: return "1.12";
+	}
+}
+
 static inline long long packKey(int rx, int rz) {
 	return ((long long)rx << 32) ^ (long long)(rz & 0xffffffff);
 }
 
+static inline int keyX(long long key) { return (int)(key >> 32); }
+static inline int keyZ(long long key) { return (int)(uint32_t)(key & 0xffffffff); }
+
 static void ensureDir(const std::string& path) {
 	mkdir(path.c_str(), 0755);
 }
 
-AnvilWriter::AnvilWriter(const std::string& worldDir): worldDir(worldDir) {
+static inline int floorDiv32(int v) { return v >= 0 ? v / 32 : -((31 - v) / 32); }
+static inline int floorMod32(int v) { return v - floorDiv32(v) * 32; }
+
+static inline uint32_t readBE32(const uint8_t* p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void writeBE32(uint8_t* p, uint32_t v) {
+	p[0] = (v >> 24) & 0xFF;
+	p[1] = (v >> 16) & 0xFF;
+	p[2] = (v >> 8) & 0xFF;
+	p[3] = v & 0xFF;
+}
+
+// Copy a whole file (an existing region to its .tmp file in crash-safe mode)
+static bool copyFile(const std::string& from, const std::string& to) {
+	int in = open(from.c_str(), O_RDONLY);
+	if (in < 0) return false;
+	int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (out < 0) { ::close(in); return false; }
+	std::vector<uint8_t> buf(1 << 20);
+	bool ok = true;
+	for (;;) {
+		ssize_t n = read(in, buf.data(), buf.size());
+		if (n <= 0) { ok = n == 0; break; }
+		if (write(out, buf.data(), (size_t)n) != n) { ok = false; break; }
+	}
+	::close(in);
+	ok = ::close(out) == 0 && ok;
+	if (!ok) printf("failed to copy %s to %s\n", from.c_str(), to.c_str());
+	return ok;
+}
+
+AnvilWriter::AnvilWriter(const std::string& worldDir): worldDir(worldDir), crashSafe(false), updateExisting(false), compressor(nullptr), format(CHUNK_FORMAT_1_12),
+	ioKind(REGION_IO_AUTO), ioThreads(2), io(nullptr), maxOpenRegions(DEFAULT_MAX_OPEN_REGIONS), useClock(0) {
 	ensureDir(worldDir);
 	ensureDir(worldDir + "/region");
 }
 
 AnvilWriter::~AnvilWriter() {
 	close();
+	delete compressor;
+	delete io;
+}
+
+void AnvilWriter::setCompression(const CompressionSettings& settings) {
+	compression = settings;
+	delete compressor;
+	compressor = nullptr;
+}
+
+void AnvilWriter::setIO(RegionIOBackend backend, int threads) {
+	ioKind = backend;
+	ioThreads = threads;
+}
+
+RegionIO* AnvilWriter::getIO() {
+	if (!io) io = RegionIO::create(ioKind, ioThreads);
+	return io;
+}
+
+RegionIOBackend AnvilWriter::ioBackend() {
+	return getIO()->backend();
+}
+
+bool AnvilWriter::reclaimPayload(std::vector<uint8_t>& payload) {
+	return io && io->reclaim(payload);
+}
+
+std::string AnvilWriter::regionPath(int regionX, int regionZ) const {
+	return worldDir + "/region/r." + std::to_string(regionX) + "." + std::to_string(regionZ) + ".mca";
 }
 
 AnvilWriter::RegionFile* AnvilWriter::getRegion(int regionX, int regionZ) {
 	long long key = packKey(regionX, regionZ);
 	auto it = regions.find(key);
-	if (it != regions.end()) return it->second;
+	if (it != regions.end()) {
+		it->second->lastUse = ++useClock;
+		return it->second;
+	}
+	if (maxOpenRegions && regions.size() >= maxOpenRegions) evictRegion();
 	RegionFile* rf = new RegionFile();
-	rf->path = worldDir + "/region/r." + std::to_string(regionX) + "." + std::to_string(regionZ) + ".mca";
-	rf->fp = fopen(rf->path.c_str(), "wb+");
-	if (!rf->fp) return nullptr;
-	// init header 8KB
+	rf->finalPath = regionPath(regionX, regionZ);
+	rf->path = crashSafe ? rf->finalPath + ".tmp" : rf->finalPath;
+	rf->lastUse = ++useClock;
+	auto done = finished.find(key);
+	if (done != finished.end()) {
+		// written earlier in this run: reopen and pick up its header and sectors
+		rf->failed = !done->second;
+		finished.erase(done);
+		if (!reopenRegion(rf)) { delete rf; return nullptr; }
+		regions[key] = rf;
+		return rf;
+	}
+	if (updateExisting && access(rf->finalPath.c_str(), F_OK) == 0) {
+		// keep the chunks already there; a file without a readable header is started over
+		if (crashSafe && !copyFile(rf->finalPath, rf->path)) { delete rf; return nullptr; }
+		if (reopenRegion(rf)) {
+			regions[key] = rf;
+			return rf;
+		}
+	}
+	rf->fd = open(rf->path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (rf->fd < 0) { printf("failed to open %s\n", rf->path.c_str()); delete rf; return nullptr; }
+	// init header 8KB; the table is written on checkpoint()/close(), payloads start at sector 2
 	rf->header.assign(8192, 0);
-	// write initial header to file
-	fwrite(rf->header.data(), 1, rf->header.size(), rf->fp);
-	fflush(rf->fp);
-	// sector 0 and 1 reserved for header
-	rf->used.assign(2, true);
+	rf->sectors.reset();
 	regions[key] = rf;
 	return rf;
 }
 
-void AnvilWriter::writeChunk(int chunkX, int chunkZ,
-	const std::vector<std::vector<uint8_t>>& sectionBlocks,
-	const std::vector<std::vector<uint8_t>>& sectionData) {
-    auto floorDiv32 = [](int v) -> int { return (v >= 0) ? (v / 32) : -((31 - v) / 32); };
-    auto floorMod32 = [&](int v) -> int { int d = floorDiv32(v); return v - d * 32; };
-    int regionX = floorDiv32(chunkX);
-    int regionZ = floorDiv32(chunkZ);
-    int localX = floorMod32(chunkX);
-    int localZ = floorMod32(chunkZ);
-    // Debug: report placement
-    if (chunkX >= -2 && chunkX <= 2 && chunkZ >= -2 && chunkZ <= 2) {
-        printf("Writing chunk (%d,%d) -> region r.%d.%d.mca local(%d,%d)\n", chunkX, chunkZ, regionX, regionZ, localX, localZ);
-    }
-	RegionFile* rf = getRegion(regionX, regionZ);
-	if (!rf) return;
-
-    // Build simple HeightMap (topmost non-air Y for each (x,z))
-    std::vector<int32_t> heightMap(16*16, 0);
-    for (int z = 0; z < 16; ++z) {
-        for (int x = 0; x < 16; ++x) {
-            int h = 0;
-            for (int s = (int)sectionBlocks.size()-1; s >= 0; --s) {
-                if (sectionBlocks[s].empty()) continue;
-                for (int y = 15; y >= 0; --y) {
-                    int voxelIndex = (y * 16 + z) * 16 + x;
-                    if (sectionBlocks[s][voxelIndex] != 0) { h = s*16 + y + 1; goto hm_done; }
-                }
-            }
-            hm_done:
-            heightMap[z*16 + x] = h;
-        }
-    }
+bool AnvilWriter::reopenRegion(RegionFile* rf) {
+	rf->fd = open(rf->path.c_str(), O_RDWR);
+	if (rf->fd < 0) { printf("failed to reopen %s\n", rf->path.c_str()); return false; }
+	rf->header.assign(8192, 0);
+	if (pread(rf->fd, rf->header.data(), rf->header.size(), 0) != (ssize_t)rf->header.size()) {
+		printf("failed to read header of %s\n", rf->path.c_str());
+		::close(rf->fd);
+		return false;
+	}
+	rf->sectors.reset();
+	for (int i = 0; i < 1024; i++) {
+		uint32_t loc = readBE32(&rf->header[i * 4]);
+		if (loc) rf->sectors.claim(loc >> 8, loc & 0xFF);
+	}
+	return true;
+}
 
-    // Build NBT for chunk
-	Buffer buf;
-	beginCompound(buf, ""); // unnamed root compound (for chunk NBT it's usually named "")
-	beginCompound(buf, "Level");
-	writeInt(buf, "xPos", chunkX);
-	writeInt(buf, "zPos", chunkZ);
-	writeLong(buf, "LastUpdate", 0);
-	writeLong(buf, "InhabitedTime", 0);
-	writeByte(buf, "TerrainPopulated", 1);
-	writeByte(buf, "LightPopulated", 1);
-	writeByteArray(buf, "Biomes", std::vector<uint8_t>(256, 1)); // plains
-    writeIntArray(buf, "HeightMap", heightMap);
-    // Empty lists for entities and tile entities
-    beginList(buf, "Entities", TAG_Compound, 0);
-    beginList(buf, "TileEntities", TAG_Compound, 0);
+// Close the least recently used region. It is complete on disk (header written, synced in
+// crash-safe mode), so dropping its bookkeeping loses nothing
+void AnvilWriter::evictRegion() {
+	auto oldest = regions.end();
+	for (auto it = regions.begin(); it != regions.end(); ++it) {
+		if (oldest == regions.end() || it->second->lastUse < oldest->second->lastUse) oldest = it;
+	}
+	if (oldest != regions.end()) closeRegion(oldest);
+}
 
-    // Sections list (list of unnamed compounds)
-    int sectionCount = 0;
-    for (size_t i = 0; i < sectionBlocks.size(); ++i) if (!sectionBlocks[i].empty()) sectionCount++;
-    beginList(buf, "Sections", TAG_Compound, sectionCount);
-    for (size_t si = 0; si < sectionBlocks.size(); ++si) {
-        if (sectionBlocks[si].empty()) continue;
+void AnvilWriter::releaseRegion(int regionX, int regionZ) {
+	auto it = regions.find(packKey(regionX, regionZ));
+	if (it != regions.end()) closeRegion(it);
+}
+
+void AnvilWriter::closeRegion(std::map<long long, RegionFile*>::iterator it) {
+	// queued payloads may belong to this region
+	if (!getIO()->flush()) printf("region write failed\n");
+	finished[it->first] = finishRegion(it->second);
+	delete it->second;
+	regions.erase(it);
+}
+
+void AnvilWriter::writeChunk(int chunkX, int chunkZ, const ColumnSections& sections) {
+	if (!compressor) compressor = ChunkCompressor::create(compression);
+	if (!compressor) return;
+	const uint8_t* present[COLUMN_SECTIONS];
+	for (int s = 0; s < COLUMN_SECTIONS; s++) present[s] = sections.present[s] ? sections.blocks[s] : nullptr;
+	int32_t heightMap[256];
+	buildHeightMap(present, COLUMN_SECTIONS, heightMap);
+	std::vector<uint8_t> payload;
+	reclaimPayload(payload);
+	if (!encodeChunk(chunkX, chunkZ, sections, heightMap, nullptr, format, *compressor, payload)) return;
+	writePayload(chunkX, chunkZ, std::move(payload));
+}
+
+bool AnvilWriter::encodeChunk(int chunkX, int chunkZ,
+	const ColumnSections& sections,
+	const int32_t* heightMap,
+	const ColumnLight* light,
+	ChunkFormat format,
+	ChunkCompressor& compressor,
+	std::vector<uint8_t>& payload) {
+	static thread_local CompressedBody body;
+	if (!encodeBody(sections, heightMap, light, format, compressor, body)) return false;
+	framePayload(chunkX, chunkZ, body, compressor, payload);
+	return true;
+}
+
+// Sections of the 1.12 format: Blocks and Data as packed
+static void writeLegacySections(Buffer& buf, const ColumnSections& sections, const ColumnLight* light) {
+    for (int si = 0; si < COLUMN_SECTIONS; ++si) {
+        if (!sections.present[si]) continue;
         beginCompoundPayload(buf);
-        writeByte(buf, "Y", (int8_t)si);
+        writeTagHeader(buf, HEADER_Y);
+        buf.writeU8((uint8_t)si);
         // Blocks 4096 bytes
-        writeByteArray(buf, "Blocks", sectionBlocks[si]);
+        writeTagHeader(buf, HEADER_BLOCKS);
+        buf.writeBytes(sections.blocks[si], sizeof(sections.blocks[si]));
         // Data 2048 nibbles (packed)
-        writeByteArray(buf, "Data", sectionData[si]);
+        writeTagHeader(buf, HEADER_DATA);
+        buf.writeBytes(sections.data[si], sizeof(sections.data[si]));
         // Light arrays
-        writeByteArray(buf, "SkyLight", std::vector<uint8_t>(2048, 0xFF));
-        writeByteArray(buf, "BlockLight", std::vector<uint8_t>(2048, 0x00));
+        writeTagHeader(buf, HEADER_SKYLIGHT);
+        buf.writeBytes(light ? light->sky[si] : skeleton.fullSkyLight, 2048);
+        writeTagHeader(buf, HEADER_BLOCKLIGHT);
+        buf.writeBytes(light ? light->block[si] : skeleton.noBlockLight, 2048);
         endCompoundPayload(buf);
     }
+}
+
+// Sections of the 1.16 format: the packed ids and metas become a palette of named states and
+// bit-packed palette indices
+static void writePaletteSections(Buffer& buf, const ColumnSections& sections, const ColumnLight* light) {
+	const PaletteEntries& entries = paletteEntries();
+	static thread_local uint16_t palette[4096];
+	static thread_local uint16_t indices[4096];
+	static thread_local int64_t states[4096];
+	for (int si = 0; si < COLUMN_SECTIONS; ++si) {
+		if (!sections.present[si]) continue;
+		int size = buildPalette(sections.blocks[si], sections.data[si], palette, indices);
+		int longs = packBlockStates(indices, size, states);
+		beginCompoundPayload(buf);
+		writeTagHeader(buf, HEADER_Y);
+		buf.writeU8((uint8_t)si);
+		writeTagHeader(buf, HEADER_PALETTE);
+		buf.writeU8((uint8_t)TAG_Compound);
+		buf.writeI32(size);
+		for (int p = 0; p < size; p++) {
+			uint32_t at = entries.offset[palette[p]];
+			buf.writeBytes(entries.bytes.data.data() + at, entries.offset[palette[p] + 1] - at);
+		}
+		writeTagHeader(buf, HEADER_BLOCKSTATES);
+		buf.writeI32(longs);
+		buf.writeI64Array(states, longs);
+		writeTagHeader(buf, HEADER_SKYLIGHT);
+		buf.writeBytes(light ? light->sky[si] : skeleton.fullSkyLight, 2048);
+		writeTagHeader(buf, HEADER_BLOCKLIGHT);
+		buf.writeBytes(light ? light->block[si] : skeleton.noBlockLight, 2048);
+		endCompoundPayload(buf);
+	}
+}
+
+bool AnvilWriter::encodeBody(const ColumnSections& sections,
+	const int32_t* heightMap,
+	const ColumnLight* light,
+	ChunkFormat format,
+	ChunkCompressor& compressor,
+	CompressedBody& body) {
+    // Build NBT for chunk, compressing it as it is encoded. Each worker thread keeps its buffer
+    // (and brings its own compressor), so after the first chunk encoding runs without reallocating
+	static thread_local Buffer buf;
+	buf.clear();
+	buf.reserve(buf.flushAt + 4096);
+	buf.sink = &compressor;
+	compressor.begin(&body);
+
+	// the root and Level compounds and the position are in the head (framePayload)
+	if (format == CHUNK_FORMAT_1_16) {
+		buf.writeBytes(skeleton.paletteLevelFields.data.data(), skeleton.paletteLevelFields.data.size());
+	}
+	else {
+		buf.writeBytes(skeleton.levelFields.data.data(), skeleton.levelFields.data.size());
+		buf.writeI32Array(heightMap, 256);
+		buf.writeBytes(skeleton.sectionsStart.data.data(), skeleton.sectionsStart.data.size());
+	}
+
+    // Sections list (list of unnamed compounds)
+    int sectionCount = 0;
+    for (int i = 0; i < COLUMN_SECTIONS; ++i) if (sections.present[i]) sectionCount++;
+    buf.writeI32(sectionCount);
+	if (format == CHUNK_FORMAT_1_16) writePaletteSections(buf, sections, light);
+	else writeLegacySections(buf, sections, light);
 
 	endCompound(buf); // end Level
+	if (format == CHUNK_FORMAT_1_16) {
+		writeTagHeader(buf, HEADER_DATAVERSION);
+		buf.writeI32(DATA_VERSION_1_16);
+	}
 	endCompound(buf); // end root
 
-	// Compress with zlib (type 2 in Anvil)
-	std::vector<uint8_t> compressed = compressZlib(buf.data);
-	if (compressed.empty()) return;
+	buf.flush();
+	buf.sink = nullptr;
+	bool ok = !buf.failed;
+	return compressor.finish() && ok;
+}
 
-	// Prepare chunk payload: length (4), compression type (1), compressed data
-	std::vector<uint8_t> payload;
-	uint32_t length = (uint32_t)(1 + compressed.size());
+void AnvilWriter::framePayload(int chunkX, int chunkZ, const CompressedBody& body, const ChunkCompressor& compressor,
+	std::vector<uint8_t>& payload) {
+	static thread_local Buffer head;
+	head.clear();
+	writeTagHeader(head, HEADER_ROOT); // unnamed root compound (for chunk NBT it's usually named "")
+	writeTagHeader(head, HEADER_LEVEL);
+	writeTagHeader(head, HEADER_XPOS);
+	head.writeI32(chunkX);
+	writeTagHeader(head, HEADER_ZPOS);
+	head.writeI32(chunkZ);
+
+	// Payload: length (4), compression type (1), compressed data, zero padding to whole sectors
+	payload.clear();
+	payload.resize(PAYLOAD_HEADER);
+	compressor.frame(head.data.data(), head.data.size(), body, payload);
+
+	uint32_t length = (uint32_t)(payload.size() - 4);
 	// big endian length
-	payload.push_back((length >> 24) & 0xFF);
-	payload.push_back((length >> 16) & 0xFF);
-	payload.push_back((length >> 8) & 0xFF);
-	payload.push_back(length & 0xFF);
-	payload.push_back(2); // zlib
-	payload.insert(payload.end(), compressed.begin(), compressed.end());
+	payload[0] = (length >> 24) & 0xFF;
+	payload[1] = (length >> 16) & 0xFF;
+	payload[2] = (length >> 8) & 0xFF;
+	payload[3] = length & 0xFF;
+	payload[4] = compressor.anvilType(); // 2 = zlib, 3 = uncompressed
+	payload.resize((payload.size() + SECTOR_BYTES - 1) / SECTOR_BYTES * SECTOR_BYTES, 0);
+}
+
+uint32_t AnvilWriter::writePayload(int chunkX, int chunkZ, std::vector<uint8_t>&& payload) {
+    int regionX = floorDiv32(chunkX);
+    int regionZ = floorDiv32(chunkZ);
+    int localX = floorMod32(chunkX);
+    int localZ = floorMod32(chunkZ);
+    // Debug: report placement
+    if (chunkX >= -2 && chunkX <= 2 && chunkZ >= -2 && chunkZ <= 2) {
+        printf("Writing chunk (%d,%d) -> region r.%d.%d.mca local(%d,%d)\n", chunkX, chunkZ, regionX, regionZ, localX, localZ);
+    }
+	RegionFile* rf = getRegion(regionX, regionZ);
+	if (!rf) return 0;
 
 	// Determine number of 4096-byte sectors
 	size_t total = payload.size();
 	int sectorsNeeded = (int)((total + 4095) / 4096);
-	// find first fit
-	int offsetSector = -1;
-	int run = 0;
-	for (size_t i = 2; ; ++i) {
-		if (i >= rf->used.size()) rf->used.push_back(false);
-		if (!rf->used[i]) {
-			run++;
-			if (run == sectorsNeeded) {
-				offsetSector = (int)(i - sectorsNeeded + 1);
-				break;
-			}
-		} else {
-			run = 0;
-		}
+	if (sectorsNeeded > MAX_CHUNK_SECTORS) {
+		printf("chunk (%d,%d) needs %d sectors, more than a region file can address; skipped\n", chunkX, chunkZ, sectorsNeeded);
+		return 0;
+	}
+	int locIndex = localX + localZ * 32;
+	uint32_t oldLoc = readBE32(&rf->header[locIndex * 4]);
+	uint32_t oldSector = oldLoc >> 8, oldCount = oldLoc & 0xFF;
+	int offsetSector;
+	if (oldLoc && (uint32_t)sectorsNeeded <= oldCount) {
+		// rewrite in place, giving back whatever the chunk no longer needs
+		offsetSector = (int)oldSector;
+		rf->sectors.release(oldSector + sectorsNeeded, oldCount - sectorsNeeded);
+	}
+	else {
+		// new chunk, or one that outgrew its old sectors
+		if (oldLoc) rf->sectors.release(oldSector, oldCount);
+		offsetSector = (int)rf->sectors.allocate((uint32_t)sectorsNeeded);
 	}
-	for (int i = 0; i < sectorsNeeded; ++i) rf->used[offsetSector + i] = true;
 
-	// Seek and write payload at 4KiB * offsetSector
-	long long fileOffset = (long long)offsetSector * 4096LL;
-	fseek(rf->fp, fileOffset, SEEK_SET);
-	// pad payload to full sectors
-	std::vector<uint8_t> padded = payload;
-	padded.resize((size_t)sectorsNeeded * 4096, 0);
-    size_t wrote = fwrite(padded.data(), 1, padded.size(), rf->fp);
-	fflush(rf->fp);
+	// encodeChunk output is already sector aligned; pad anything else with zeros
+	payload.resize((size_t)sectorsNeeded * 4096, 0);
+	// Queue the payload at 4KiB * offsetSector. Chunks usually land right after the previous one,
+	// so the I/O layer writes runs of them with a single call
+	getIO()->write(rf->fd, (long long)offsetSector * 4096LL, std::move(payload));
 
 	// Update header: location entry is 3 bytes offset, 1 byte sectors
-	int locIndex = localX + localZ * 32;
 	uint32_t loc = ((uint32_t)offsetSector << 8) | (uint32_t)sectorsNeeded;
 	// write to header buffer
 	rf->header[locIndex*4 + 0] = (loc >> 24) & 0xFF;
@@ -183,19 +492,82 @@ void AnvilWriter::writeChunk(int chunkX, int chunkZ,
     rf->header[tsIndex + 1] = (ts >> 16) & 0xFF;
     rf->header[tsIndex + 2] = (ts >> 8) & 0xFF;
     rf->header[tsIndex + 3] = (ts) & 0xFF;
-	// write header back
-    fseek(rf->fp, 0, SEEK_SET);
-    fwrite(rf->header.data(), 1, rf->header.size(), rf->fp);
-	fflush(rf->fp);
+    return loc;
 }
 
-void AnvilWriter::close() {
-	for (auto& kv : regions) {
-		RegionFile* rf = kv.second;
-		if (rf->fp) fclose(rf->fp);
-		delete rf;
-	}
+bool AnvilWriter::removeChunk(int chunkX, int chunkZ) {
+	int regionX = floorDiv32(chunkX), regionZ = floorDiv32(chunkZ);
+	long long key = packKey(regionX, regionZ);
+	// don't create (or, when not updating, start over) a region just to find it has no such chunk
+	if (!regions.count(key) && !finished.count(key) && (!updateExisting || access(regionPath(regionX, regionZ).c_str(), F_OK) != 0)) return false;
+	RegionFile* rf = getRegion(regionX, regionZ);
+	if (!rf) return false;
+	int locIndex = floorMod32(chunkX) + floorMod32(chunkZ) * 32;
+	uint32_t loc = readBE32(&rf->header[locIndex * 4]);
+	if (!loc) return false;
+	rf->sectors.release(loc >> 8, loc & 0xFF);
+	writeBE32(&rf->header[locIndex * 4], 0);
+	writeBE32(&rf->header[4096 + locIndex * 4], 0);
+	return true;
+}
+
+bool AnvilWriter::storedLocations(int regionX, int regionZ, uint32_t locations[1024]) const {
+	int fd = open(regionPath(regionX, regionZ).c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	uint8_t table[4096];
+	bool ok = pread(fd, table, sizeof(table), 0) == (ssize_t)sizeof(table);
+	::close(fd);
+	if (!ok) return false;
+	for (int i = 0; i < 1024; i++) locations[i] = readBE32(table + i * 4);
+	return true;
+}
+
+// Callers flush the I/O layer first, so the table never points at unwritten sectors
+bool AnvilWriter::writeHeader(RegionFile* rf) {
+	if (rf->fd < 0) return false;
+	return pwrite(rf->fd, rf->header.data(), rf->header.size(), 0) == (ssize_t)rf->header.size() && !getIO()->failed(rf->fd);
+}
+
+void AnvilWriter::checkpoint() {
+	if (!getIO()->flush()) printf("region write failed\n");
+	for (auto& kv : regions) writeHeader(kv.second);
+}
+
+// Write the header and close the file; the I/O layer must be flushed
+bool AnvilWriter::finishRegion(RegionFile* rf) {
+	if (rf->fd < 0) return false;
+	bool ok = writeHeader(rf) && !rf->failed;
+	// drop sectors freed at the end by rewrites
+	ok = ftruncate(rf->fd, (off_t)rf->sectors.end() * 4096) == 0 && ok;
+	getIO()->forget(rf->fd);
+	if (crashSafe) ok = fsync(rf->fd) == 0 && ok;
+	ok = ::close(rf->fd) == 0 && ok;
+	rf->fd = -1;
+	return ok;
+}
+
+bool AnvilWriter::close() {
+	if (io && !io->flush()) printf("region write failed\n");
+	for (auto& kv : regions) finished[kv.first] = finishRegion(kv.second);
+	for (auto& kv : regions) delete kv.second;
 	regions.clear();
+	if (crashSafe) {
+		// only a complete region replaces the old file
+		for (auto& kv : finished) {
+			std::string finalPath = regionPath(keyX(kv.first), keyZ(kv.first));
+			std::string path = finalPath + ".tmp";
+			if (kv.second) {
+				if (rename(path.c_str(), finalPath.c_str()) != 0) printf("failed to rename %s\n", path.c_str());
+			}
+			else {
+				printf("failed to finish %s, leaving %s untouched\n", path.c_str(), finalPath.c_str());
+			}
+		}
+	}
+	bool ok = true;
+	for (auto& kv : finished) ok = ok && kv.second;
+	finished.clear();
+	return ok;
 }
 
 
@@ -1,31 +1,144 @@
 #pragma once
+#include "Compression.h"
+#include "RegionIO.h"
 #include <cstdint>
 #include <map>
 #include <vector>
 #include <string>
 
-// Minimal Anvil (.mca) region/chunk writer for Minecraft 1.12
+// Minimal Anvil (.mca) region/chunk writer for Minecraft 1.12, or 1.16 chunk NBT
+
+struct ColumnLight;
+
+// Layout of the chunk NBT
+enum ChunkFormat {
+	CHUNK_FORMAT_1_12 = 0, // Blocks/Data byte arrays with numeric ids (1.2 - 1.12)
+	CHUNK_FORMAT_1_16      // per-section Palette of named block states and a BlockStates long array
+};
+
+// Parse "1.12", "1.16"; false if the text is not understood
+bool parseChunkFormat(const char* text, ChunkFormat& out);
+const char* chunkFormatName(ChunkFormat format);
+
+// Sections per chunk column; Eden worlds are 64 blocks tall
+static const int COLUMN_SECTIONS = 4;
+
+// Packed Anvil sections of one chunk column in a single fixed-size block, so a worker reuses one
+// for every column instead of allocating per section. Only present sections hold data;
+// an absent one is all air and is omitted from the chunk
+struct ColumnSections {
+	uint8_t blocks[COLUMN_SECTIONS][4096]; // block ids, (y*16+z)*16+x
+	uint8_t data[COLUMN_SECTIONS][2048];   // Data nibbles, even x in the low nibble
+	bool present[COLUMN_SECTIONS];
+};
 
 class AnvilWriter {
 public:
 	explicit AnvilWriter(const std::string& worldDir);
 	~AnvilWriter();
 
-	// Write a single chunk at (chunkX, chunkZ) with provided 16x16x16 section blocks
-	// sectionsBlocks: vector of 4 sections (Y=0..3), each 4096 block IDs and 4096 data nibbles
-	// height up to 64 is supported; higher sections are omitted
-	void writeChunk(int chunkX, int chunkZ,
-		const std::vector<std::vector<uint8_t>>& sectionBlocks,
-		const std::vector<std::vector<uint8_t>>& sectionData);
+	// Write a single chunk at (chunkX, chunkZ) with provided 16x16x16 sections (Y=0..3);
+	// height up to 64 is supported
+	void writeChunk(int chunkX, int chunkZ, const ColumnSections& sections);
+
+	// Build the region payload for a chunk (length, compression type, compressed NBT), zero padded
+	// to whole 4 KiB sectors so it can be written as is. The NBT is deflated while it is encoded.
+	// heightMap holds 256 heights at z*16+x (see buildHeightMap). light holds computed sky and block
+	// light (see LightEngine); without it sections get full skylight and no block light.
+	// The 1.16 format leaves out the heightmaps, the game computes them when it loads the chunk.
+	// Touches no writer state, so conversion workers may call it concurrently; reusing the same
+	// payload vector across calls avoids reallocating it
+	static bool encodeChunk(int chunkX, int chunkZ,
+		const ColumnSections& sections,
+		const int32_t* heightMap,
+		const ColumnLight* light,
+		ChunkFormat format,
+		ChunkCompressor& compressor,
+		std::vector<uint8_t>& payload);
+
+	// encodeChunk in two steps. The chunk NBT is split into a head (root, Level and the chunk position)
+	// and a body with everything else; only the body is compressed, so one body serves every chunk
+	// with the same content. framePayload puts a head for (chunkX, chunkZ) in front of a body
+	static bool encodeBody(const ColumnSections& sections,
+		const int32_t* heightMap,
+		const ColumnLight* light,
+		ChunkFormat format,
+		ChunkCompressor& compressor,
+		CompressedBody& body);
+	static void framePayload(int chunkX, int chunkZ, const CompressedBody& body, const ChunkCompressor& compressor,
+		std::vector<uint8_t>& payload);
+
+	// Store a payload from encodeChunk in its region file; only one thread may write at a time.
+	// The buffer is handed to the I/O layer and comes back through reclaimPayload() once written.
+	// Returns the chunk's region header entry (first sector << 8 | sector count), 0 if not written
+	uint32_t writePayload(int chunkX, int chunkZ, std::vector<uint8_t>&& payload);
+
+	// Drop a chunk from its region file, freeing its sectors; false if there was none. A region file
+	// that this run has not opened is only looked at when updating existing files
+	bool removeChunk(int chunkX, int chunkZ);
+
+	// Location table of region file r.regionX.regionZ.mca as it is on disk; false if there is no
+	// such file or it has no complete header
+	bool storedLocations(int regionX, int regionZ, uint32_t locations[1024]) const;
+
+	// A payload buffer whose write completed, for reuse by encodeChunk; false if none is ready
+	bool reclaimPayload(std::vector<uint8_t>& payload);
+
+	// Location/timestamp headers are kept in memory and only written here and by close()
+	void checkpoint();
+
+	// Finish and close one region now (e.g. when all its chunks are written); a later chunk reopens it
+	void releaseRegion(int regionX, int regionZ);
+
+	// Write headers, flush and close all region files; false if any region failed to complete
+	bool close();
+
+	// Write each region to r.x.z.mca.tmp and rename it over r.x.z.mca once it is complete
+	// (fsync'd) on close(), so a crash never leaves a region with a stale or partial header
+	void setCrashSafe(bool enable) { crashSafe = enable; }
+
+	// Keep the chunks of region files already in the directory and write chunks into them
+	// (default off: an existing region file is started over)
+	void setUpdateExisting(bool enable) { updateExisting = enable; }
+
+	// How region data reaches the disk (before the first chunk is written); threads is the
+	// pool size of the thread backend
+	void setIO(RegionIOBackend backend, int threads);
+	RegionIOBackend ioBackend();
+
+	// At most this many region files stay open (0 = no limit, default 256). The least recently used
+	// one is finished and closed to make room, and reopened if a later chunk lands in it
+	void setMaxOpenRegions(size_t n) { maxOpenRegions = n; }
+
+	// Compression used by writeChunk (encodeChunk callers bring their own compressor)
+	void setCompression(const CompressionSettings& settings);
 
-	// Flush and close all region files
-	void close();
+	// Chunk NBT layout used by writeChunk (default 1.12)
+	void setChunkFormat(ChunkFormat f) { format = f; }
 
 private:
 	struct RegionFile;
 	RegionFile* getRegion(int regionX, int regionZ);
+	bool reopenRegion(RegionFile* rf);
+	void evictRegion();
+	void closeRegion(std::map<long long, RegionFile*>::iterator it);
+	bool finishRegion(RegionFile* rf);
+	bool writeHeader(RegionFile* rf);
+	std::string regionPath(int regionX, int regionZ) const;
+	RegionIO* getIO();
 	std::string worldDir;
+	bool crashSafe;
+	bool updateExisting;
 	std::map<long long, RegionFile*> regions;
+	CompressionSettings compression;
+	ChunkCompressor* compressor;
+	ChunkFormat format;
+	RegionIOBackend ioKind;
+	int ioThreads;
+	RegionIO* io;
+	size_t maxOpenRegions;
+	unsigned long long useClock;
+	std::map<long long, bool> finished; // closed regions (evicted or at close()) and whether they completed cleanly
 };
 
 
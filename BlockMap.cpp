@@ -117,7 +117,7 @@ static std::unordered_map<int, std::string> blockEnumToName = {
     {TYPE_STEEL, "Block of Iron"},
 };
 
-bool mapEdenToMinecraft(int8_t edenId, uint8_t /*edenColor*/, uint8_t& mcId, uint8_t& mcData) {
+bool mapEdenToMinecraftByName(int8_t edenId, uint8_t /*edenColor*/, uint8_t& mcId, uint8_t& mcData) {
     if (edenId <= 0) return false; // air
 
     // JSON/mapping driven logic
@@ -174,4 +174,132 @@ bool mapEdenToMinecraft(int8_t edenId, uint8_t /*edenColor*/, uint8_t& mcId, uin
             pick(1, 0, mcId, mcData);
             return true;
     }
-}
\ No newline at end of file
+}
+
+static MCMapping edenTable[256];
+
+static bool buildEdenTable() {
+    for (int i = 0; i < 256; ++i) {
+        MCMapping& m = edenTable[i];
+        m.id = 0; m.meta = 0;
+        m.place = mapEdenToMinecraftByName((int8_t)i, 0, m.id, m.meta) ? 1 : 0;
+        if (!m.place) { m.id = 0; m.meta = 0; }
+    }
+    return true;
+}
+
+const MCMapping* edenToMinecraftTable() {
+    // built on first use; function statics are initialized exactly once even with several workers
+    static bool built = buildEdenTable();
+    (void)built;
+    return edenTable;
+}
+
+struct LegacyState { uint8_t id; uint8_t meta; ModernBlockState state; };
+
+// 1.12 -> 1.13 names as the game's own upgrade renames them. Stairs meta 0..3 face east, west,
+// south, north. Door meta 0..7 is the lower half (bits 0-1 facing east, south, west, north, bit 2
+// open), 8..11 the upper half (bit 0 right hinge, bit 1 powered), whose facing 1.12 took from the
+// lower half. Vine meta bits are the faces it hangs on: 1 south, 2 west, 4 north, 8 east; 0 hangs
+// from the block above. Leaves are made persistent: 1.12 leaves only decay after a neighbour update,
+// flattened non-persistent leaves away from logs decay on their own
+static const LegacyState legacyStates[] = {
+    {0, 0, {"minecraft:air", {}}},
+    {1, 0, {"minecraft:stone", {}}},
+    {1, 5, {"minecraft:andesite", {}}},
+    {2, 0, {"minecraft:grass_block", {}}},
+    {3, 0, {"minecraft:dirt", {}}},
+    {4, 0, {"minecraft:cobblestone", {}}},
+    {5, 0, {"minecraft:oak_planks", {}}},
+    {5, 3, {"minecraft:jungle_planks", {}}},
+    {7, 0, {"minecraft:bedrock", {}}},
+    {9, 0, {"minecraft:water", {}}},
+    {11, 0, {"minecraft:lava", {}}},
+    {17, 0, {"minecraft:oak_log", {}}},
+    {18, 0, {"minecraft:oak_leaves", {{"persistent", "true"}}}},
+    {20, 0, {"minecraft:glass", {}}},
+    {24, 2, {"minecraft:cut_sandstone", {}}},
+    {35, 0, {"minecraft:white_wool", {}}},
+    {38, 0, {"minecraft:poppy", {}}},
+    {42, 0, {"minecraft:iron_block", {}}},
+    {45, 0, {"minecraft:bricks", {}}},
+    {46, 0, {"minecraft:tnt", {}}},
+    {48, 0, {"minecraft:mossy_cobblestone", {}}},
+    {53, 0, {"minecraft:oak_stairs", {{"facing", "east"}}}},
+    {53, 1, {"minecraft:oak_stairs", {{"facing", "west"}}}},
+    {53, 2, {"minecraft:oak_stairs", {{"facing", "south"}}}},
+    {53, 3, {"minecraft:oak_stairs", {{"facing", "north"}}}},
+    {64, 0, {"minecraft:oak_door", {{"half", "lower"}, {"facing", "east"}, {"open", "false"}, {"hinge", "left"}, {"powered", "false"}}}},
+    {64, 1, {"minecraft:oak_door", {{"half", "lower"}, {"facing", "south"}, {"open", "false"}, {"hinge", "left"}, {"powered", "false"}}}},
+    {64, 2, {"minecraft:oak_door", {{"half", "lower"}, {"facing", "west"}, {"open", "false"}, {"hinge", "left"}, {"powered", "false"}}}},
+    {64, 3, {"minecraft:oak_door", {{"half", "lower"}, {"facing", "north"}, {"open", "false"}, {"hinge", "left"}, {"powered", "false"}}}},
+    {64, 4, {"minecraft:oak_door", {{"half", "lower"}, {"facing", "east"}, {"open", "true"}, {"hinge", "left"}, {"powered", "false"}}}},
+    {64, 5, {"minecraft:oak_door", {{"half", "lower"}, {"facing", "south"}, {"open", "true"}, {"hinge", "left"}, {"powered", "false"}}}},
+    {64, 6, {"minecraft:oak_door", {{"half", "lower"}, {"facing", "west"}, {"open", "true"}, {"hinge", "left"}, {"powered", "false"}}}},
+    {64, 7, {"minecraft:oak_door", {{"half", "lower"}, {"facing", "north"}, {"open", "true"}, {"hinge", "left"}, {"powered", "false"}}}},
+    {64, 8, {"minecraft:oak_door", {{"half", "upper"}, {"facing", "east"}, {"open", "false"}, {"hinge", "left"}, {"powered", "false"}}}},
+    {64, 9, {"minecraft:oak_door", {{"half", "upper"}, {"facing", "east"}, {"open", "false"}, {"hinge", "right"}, {"powered", "false"}}}},
+    {64, 10, {"minecraft:oak_door", {{"half", "upper"}, {"facing", "east"}, {"open", "false"}, {"hinge", "left"}, {"powered", "true"}}}},
+    {64, 11, {"minecraft:oak_door", {{"half", "upper"}, {"facing", "east"}, {"open", "false"}, {"hinge", "right"}, {"powered", "true"}}}},
+    {67, 0, {"minecraft:cobblestone_stairs", {{"facing", "east"}}}},
+    {67, 1, {"minecraft:cobblestone_stairs", {{"facing", "west"}}}},
+    {67, 2, {"minecraft:cobblestone_stairs", {{"facing", "south"}}}},
+    {67, 3, {"minecraft:cobblestone_stairs", {{"facing", "north"}}}},
+    {85, 0, {"minecraft:oak_fence", {}}},
+    {89, 0, {"minecraft:glowstone", {}}},
+    {98, 0, {"minecraft:stone_bricks", {}}},
+    {106, 0, {"minecraft:vine", {{"south", "false"}, {"west", "false"}, {"north", "false"}, {"east", "false"}, {"up", "true"}}}},
+    {106, 1, {"minecraft:vine", {{"south", "true"}, {"west", "false"}, {"north", "false"}, {"east", "false"}, {"up", "false"}}}},
+    {106, 2, {"minecraft:vine", {{"south", "false"}, {"west", "true"}, {"north", "false"}, {"east", "false"}, {"up", "false"}}}},
+    {106, 3, {"minecraft:vine", {{"south", "true"}, {"west", "true"}, {"north", "false"}, {"east", "false"}, {"up", "false"}}}},
+    {106, 4, {"minecraft:vine", {{"south", "false"}, {"west", "false"}, {"north", "true"}, {"east", "false"}, {"up", "false"}}}},
+    {106, 5, {"minecraft:vine", {{"south", "true"}, {"west", "false"}, {"north", "true"}, {"east", "false"}, {"up", "false"}}}},
+    {106, 6, {"minecraft:vine", {{"south", "false"}, {"west", "true"}, {"north", "true"}, {"east", "false"}, {"up", "false"}}}},
+    {106, 7, {"minecraft:vine", {{"south", "true"}, {"west", "true"}, {"north", "true"}, {"east", "false"}, {"up", "false"}}}},
+    {106, 8, {"minecraft:vine", {{"south", "false"}, {"west", "false"}, {"north", "false"}, {"east", "true"}, {"up", "false"}}}},
+    {106, 9, {"minecraft:vine", {{"south", "true"}, {"west", "false"}, {"north", "false"}, {"east", "true"}, {"up", "false"}}}},
+    {106, 10, {"minecraft:vine", {{"south", "false"}, {"west", "true"}, {"north", "false"}, {"east", "true"}, {"up", "false"}}}},
+    {106, 11, {"minecraft:vine", {{"south", "true"}, {"west", "true"}, {"north", "false"}, {"east", "true"}, {"up", "false"}}}},
+    {106, 12, {"minecraft:vine", {{"south", "false"}, {"west", "false"}, {"north", "true"}, {"east", "true"}, {"up", "false"}}}},
+    {106, 13, {"minecraft:vine", {{"south", "true"}, {"west", "false"}, {"north", "true"}, {"east", "true"}, {"up", "false"}}}},
+    {106, 14, {"minecraft:vine", {{"south", "false"}, {"west", "true"}, {"north", "true"}, {"east", "true"}, {"up", "false"}}}},
+    {106, 15, {"minecraft:vine", {{"south", "true"}, {"west", "true"}, {"north", "true"}, {"east", "true"}, {"up", "false"}}}},
+    {112, 0, {"minecraft:nether_bricks", {}}},
+    {114, 0, {"minecraft:nether_brick_stairs", {{"facing", "east"}}}},
+    {114, 1, {"minecraft:nether_brick_stairs", {{"facing", "west"}}}},
+    {114, 2, {"minecraft:nether_brick_stairs", {{"facing", "south"}}}},
+    {114, 3, {"minecraft:nether_brick_stairs", {{"facing", "north"}}}},
+    {139, 0, {"minecraft:cobblestone_wall", {}}},
+    {155, 0, {"minecraft:quartz_block", {}}},
+    {155, 1, {"minecraft:chiseled_quartz_block", {}}},
+    {156, 0, {"minecraft:quartz_stairs", {{"facing", "east"}}}},
+    {156, 1, {"minecraft:quartz_stairs", {{"facing", "west"}}}},
+    {156, 2, {"minecraft:quartz_stairs", {{"facing", "south"}}}},
+    {156, 3, {"minecraft:quartz_stairs", {{"facing", "north"}}}},
+    {159, 0, {"minecraft:white_terracotta", {}}},
+    {169, 0, {"minecraft:sea_lantern", {}}},
+    {173, 0, {"minecraft:coal_block", {}}},
+};
+
+static const ModernBlockState* modernTable[256 * 16];
+
+static bool buildModernTable() {
+    const ModernBlockState* stone = nullptr;
+    for (const LegacyState& s : legacyStates) {
+        modernTable[s.id * 16 + s.meta] = &s.state;
+        if (s.id == 1 && s.meta == 0) stone = &s.state;
+    }
+    for (int id = 0; id < 256; ++id) {
+        const ModernBlockState* base = modernTable[id * 16] ? modernTable[id * 16] : stone;
+        for (int meta = 0; meta < 16; ++meta) {
+            if (!modernTable[id * 16 + meta]) modernTable[id * 16 + meta] = base;
+        }
+    }
+    return true;
+}
+
+const ModernBlockState& modernBlockState(uint8_t mcId, uint8_t mcMeta) {
+    static bool built = buildModernTable();
+    (void)built;
+    return *modernTable[mcId * 16 + (mcMeta & 0x0F)];
+}
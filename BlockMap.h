@@ -1,8 +1,38 @@
 #pragma once
 #include <cstdint>
 
+// Minecraft id/meta for one Eden block id; place == 0 means air
+struct MCMapping {
+    uint8_t id;
+    uint8_t meta;
+    uint8_t place;
+};
+
+// Flat 256-entry table indexed by (uint8_t)edenId, built once from the name tables in BlockMap.cpp.
+// Eden color doesn't affect the mapping yet, so the id alone is the index
+const MCMapping* edenToMinecraftTable();
+
+// Name-table driven lookup the flat table is built from (slow: several hash and string operations)
+bool mapEdenToMinecraftByName(int8_t edenId, uint8_t edenColor, uint8_t& mcId, uint8_t& mcData);
+
 // Map Eden block ID (+optional color) to Minecraft 1.12 block ID and data (meta)
 // Returns false for air/empty; true if a block should be placed
-bool mapEdenToMinecraft(int8_t edenId, uint8_t edenColor, uint8_t& mcId, uint8_t& mcData);
+inline bool mapEdenToMinecraft(int8_t edenId, uint8_t /*edenColor*/, uint8_t& mcId, uint8_t& mcData) {
+    const MCMapping& m = edenToMinecraftTable()[(uint8_t)edenId];
+    if (!m.place) return false;
+    mcId = m.id;
+    mcData = m.meta;
+    return true;
+}
+
 
+// Block state of the flattened (1.13+) format for a 1.12 id/meta: the namespaced name and up to
+// five properties (a door has that many); properties left out keep the block's default
+struct ModernBlockState {
+    const char* name;
+    const char* properties[5][2]; // {key, value}; unused pairs have a null key
+};
 
+// Covers air and every id/meta the Eden table produces; any other meta of a known id falls back
+// to the id's meta 0 state, unknown ids to stone
+const ModernBlockState& modernBlockState(uint8_t mcId, uint8_t mcMeta);
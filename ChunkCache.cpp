@@ -0,0 +1,143 @@
+#include "ChunkCache.h"
+#include <algorithm>
+#include <cstring>
+
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+
+static inline uint64_t xxRound(uint64_t acc, uint64_t input) {
+	acc += input * PRIME2;
+	acc = rotl64(acc, 31);
+	return acc * PRIME1;
+}
+
+static inline uint64_t mergeRound(uint64_t h, uint64_t v) {
+	h ^= xxRound(0, v);
+	return h * PRIME1 + PRIME4;
+}
+
+static inline uint64_t avalanche(uint64_t h) {
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+// XXH64 reads its input little-endian
+static inline uint64_t read64(const uint8_t* p) {
+	uint64_t v;
+	memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline uint32_t read32(const uint8_t* p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+// XXH64 finish: fold the lanes (inputs of 32 bytes or more), then the bytes of the last partial stripe
+static uint64_t finish(const uint64_t v[4], uint64_t seed, uint64_t total, const uint8_t* p, size_t n) {
+	uint64_t h;
+	if (total >= 32) {
+		h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18);
+		for (int i = 0; i < 4; i++) h = mergeRound(h, v[i]);
+	}
+	else {
+		h = seed + PRIME5;
+	}
+	h += total;
+	for (; n >= 8; p += 8, n -= 8) h = rotl64(h ^ xxRound(0, read64(p)), 27) * PRIME1 + PRIME4;
+	if (n >= 4) {
+		h = rotl64(h ^ (uint64_t)read32(p) * PRIME1, 23) * PRIME2 + PRIME3;
+		p += 4;
+		n -= 4;
+	}
+	for (; n > 0; p++, n--) h = rotl64(h ^ *p * PRIME5, 11) * PRIME1;
+	return avalanche(h);
+}
+
+ContentHasher::ContentHasher(): tailSize(0), total(0) {
+	for (int s = 0; s < 2; s++) {
+		uint64_t seed = CONTENT_HASH_SEEDS[s];
+		lanes[s][0] = seed + PRIME1 + PRIME2;
+		lanes[s][1] = seed + PRIME2;
+		lanes[s][2] = seed;
+		lanes[s][3] = seed - PRIME1;
+	}
+}
+
+void ContentHasher::stripe(const uint8_t* p) {
+	for (int i = 0; i < 4; i++) {
+		uint64_t in = read64(p + i * 8);
+		lanes[0][i] = xxRound(lanes[0][i], in);
+		lanes[1][i] = xxRound(lanes[1][i], in);
+	}
+}
+
+void ContentHasher::update(const void* data, size_t n) {
+	const uint8_t* p = (const uint8_t*)data;
+	total += n;
+	if (tailSize) {
+		size_t take = std::min(sizeof(tail) - tailSize, n);
+		memcpy(tail + tailSize, p, take);
+		tailSize += take;
+		p += take;
+		n -= take;
+		if (tailSize < sizeof(tail)) return;
+		stripe(tail);
+		tailSize = 0;
+	}
+	for (; n >= 32; p += 32, n -= 32) stripe(p);
+	memcpy(tail, p, n);
+	tailSize = n;
+}
+
+ContentHash ContentHasher::digest() const {
+	ContentHash h;
+	h.lo = finish(lanes[0], CONTENT_HASH_SEEDS[0], total, tail, tailSize);
+	h.hi = finish(lanes[1], CONTENT_HASH_SEEDS[1], total, tail, tailSize);
+	return h;
+}
+
+// Slots of the seen-once filter (512 KiB)
+static const size_t SEEN_SLOTS = 1 << 16;
+
+ChunkCache::ChunkCache(size_t maxBytes): seen(SEEN_SLOTS, 0), bytes(0), maxBytes(maxBytes) {}
+
+std::shared_ptr<const CompressedBody> ChunkCache::find(const ContentHash& key) {
+	std::lock_guard<std::mutex> lock(m);
+	auto it = entries.find(key);
+	if (it == entries.end()) return nullptr;
+	return it->second;
+}
+
+void ChunkCache::insert(const ContentHash& key, const CompressedBody& body) {
+	{
+		std::lock_guard<std::mutex> lock(m);
+		if (bytes + body.data.size() > maxBytes || entries.count(key)) return;
+		uint64_t& tag = seen[key.lo & (SEEN_SLOTS - 1)];
+		if (tag != key.hi) {
+			tag = key.hi;
+			return;
+		}
+	}
+	// copy outside the lock; another worker may store the same key meanwhile, the first one stays
+	std::shared_ptr<const CompressedBody> copy = std::make_shared<const CompressedBody>(body);
+	std::lock_guard<std::mutex> lock(m);
+	if (bytes + body.data.size() > maxBytes) return;
+	if (entries.emplace(key, copy).second) bytes += body.data.size();
+}
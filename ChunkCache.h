@@ -0,0 +1,68 @@
+#pragma once
+#include "Compression.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Content-addressed reuse of encoded chunks. Eden worlds repeat whole columns (flat ground, solid
+// stone, empty sky); a column whose inputs hash the same as an earlier one gets that column's
+// compressed body and only has its head (the chunk position) framed again.
+
+// 128-bit content hash: XXH64 of the same bytes under two seeds, CONTENT_HASH_SEEDS[0] for lo
+// and [1] for hi. Not cryptographic, but wide enough that accidental collisions never happen
+struct ContentHash {
+	uint64_t lo, hi;
+	bool operator==(const ContentHash& o) const { return lo == o.lo && hi == o.hi; }
+};
+
+static const uint64_t CONTENT_HASH_SEEDS[2] = { 0, 0x9E3779B97F4A7C15ULL };
+
+// Changes whenever ContentHasher gives different hashes for the same bytes. Hashes are stored in
+// conversion manifests, which are only reused with the same version
+static const uint32_t CONTENT_HASH_VERSION = 1;
+
+// Streaming XXH64 as specified by the reference implementation (input read little-endian), run
+// under both seeds in one pass
+class ContentHasher {
+public:
+	ContentHasher();
+	void update(const void* data, size_t n);
+	ContentHash digest() const;
+
+private:
+	void stripe(const uint8_t* p);
+
+	uint64_t lanes[2][4];
+	uint8_t tail[32]; // bytes of an incomplete stripe
+	size_t tailSize;
+	uint64_t total;
+};
+
+// Compressed chunk bodies by content hash, shared by every conversion worker
+class ChunkCache {
+public:
+	explicit ChunkCache(size_t maxBytes);
+
+	// The body stored under key, or nullptr. Bodies are never modified once stored
+	std::shared_ptr<const CompressedBody> find(const ContentHash& key);
+
+	// Keep a copy of body under key, but only from the second time key is offered: content seen
+	// once is usually unique, and copying it would cost an allocation per column. Once maxBytes of
+	// bodies are held, new ones are not stored
+	void insert(const ContentHash& key, const CompressedBody& body);
+
+private:
+	struct KeyHash {
+		size_t operator()(const ContentHash& h) const { return (size_t)h.lo; }
+	};
+
+	std::mutex m;
+	std::unordered_map<ContentHash, std::shared_ptr<const CompressedBody>, KeyHash> entries;
+	// keys offered once, by key.lo slot; a lossy filter, a lost key only costs one more encode
+	std::vector<uint64_t> seen;
+	size_t bytes;
+	size_t maxBytes;
+};
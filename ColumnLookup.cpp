@@ -0,0 +1,51 @@
+#include "ColumnLookup.h"
+
+uint32_t ColumnLookup::hashOf(int x, int z) {
+	// murmur3 finalizer over the packed coordinates
+	uint64_t k = ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return (uint32_t)k;
+}
+
+void ColumnLookup::reset(int n) {
+	// keep the load factor at or below one half
+	uint32_t cap = 16;
+	while (cap < (uint32_t)n * 2) cap <<= 1;
+	slots.assign(cap, Slot{0, 0, -1});
+	mask = cap - 1;
+	count = 0;
+}
+
+void ColumnLookup::insert(int x, int z, int index) {
+	if ((uint32_t)(count + 1) * 2 > mask + 1) {
+		// grow and rehash if more columns arrive than reset() was told about
+		std::vector<Slot> old;
+		old.swap(slots);
+		reset(count + 1);
+		for (const Slot& s : old) if (s.index >= 0) insert(s.x, s.z, s.index);
+	}
+	for (uint32_t i = hashOf(x, z) & mask; ; i = (i + 1) & mask) {
+		Slot& s = slots[i];
+		if (s.index < 0) {
+			s.x = x;
+			s.z = z;
+			s.index = index;
+			count++;
+			return;
+		}
+		if (s.x == x && s.z == z) return;
+	}
+}
+
+int ColumnLookup::find(int x, int z) const {
+	if (slots.empty()) return -1;
+	for (uint32_t i = hashOf(x, z) & mask; ; i = (i + 1) & mask) {
+		const Slot& s = slots[i];
+		if (s.index < 0) return -1;
+		if (s.x == x && s.z == z) return s.index;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Open-addressing hash from a column's (x,z) to its position in the column directory.
+// Built once after the directory is read; point lookups are O(1) instead of a scan over every column
+
+class ColumnLookup {
+public:
+	// Drop old contents and size the table for count columns
+	void reset(int count);
+
+	// Add a column; if (x,z) is already present the first entry wins, like the old linear scan
+	void insert(int x, int z, int index);
+
+	// Directory position of column (x,z), or -1 if the world has no such column
+	int find(int x, int z) const;
+
+	// Call fn(x, z, index) for every column present in [minX..maxX] x [minZ..maxZ]
+	template <typename Fn>
+	void forEachInBox(int minX, int minZ, int maxX, int maxZ, Fn fn) const {
+		for (int x = minX; x <= maxX; x++) {
+			for (int z = minZ; z <= maxZ; z++) {
+				int idx = find(x, z);
+				if (idx >= 0) fn(x, z, idx);
+			}
+		}
+	}
+
+	int size() const { return count; }
+
+private:
+	struct Slot {
+		int x, z;
+		int index; // -1 marks an empty slot
+	};
+	static uint32_t hashOf(int x, int z);
+	std::vector<Slot> slots;
+	uint32_t mask = 0;
+	int count = 0;
+};
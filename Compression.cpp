@@ -0,0 +1,221 @@
+#include "Compression.h"
+#include "Profiler.h"
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+
+// opt-in, since it needs -ldeflate at link time
+#if defined(EDEN_WITH_LIBDEFLATE) && defined(__has_include)
+#if __has_include(<libdeflate.h>)
+#define EDEN_HAVE_LIBDEFLATE 1
+#include <libdeflate.h>
+#endif
+#endif
+
+void ChunkCompressor::begin(CompressedBody* out) {
+	body = out;
+	body->data.clear();
+	body->checksum = (uint32_t)adler32(0L, Z_NULL, 0);
+	body->inputSize = 0;
+	start(&body->data);
+}
+
+bool ChunkCompressor::write(const uint8_t* p, size_t n) {
+	if (!body) return false;
+	ProfileScope scope(STAGE_COMPRESS);
+	// the zlib checksum covers head and body, frame() combines the two
+	if (anvilType() == 2) body->checksum = (uint32_t)adler32(body->checksum, p, (uInt)n);
+	body->inputSize += n;
+	return compress(p, n);
+}
+
+bool ChunkCompressor::finish() {
+	ProfileScope scope(STAGE_COMPRESS);
+	bool ok = body && end();
+	body = nullptr;
+	return ok;
+}
+
+void ChunkCompressor::frame(const uint8_t* head, size_t headSize, const CompressedBody& compressed, std::vector<uint8_t>& out) const {
+	if (anvilType() != 2) {
+		out.insert(out.end(), head, head + headSize);
+		out.insert(out.end(), compressed.data.begin(), compressed.data.end());
+		return;
+	}
+	// zlib header (deflate, 32K window), with the level hint zlib itself would write
+	int levelFlags = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+	unsigned header = (0x78 << 8) | (levelFlags << 6);
+	header += 31 - header % 31;
+	// the head as a stored, non-final deflate block: block header byte, LEN, NLEN (little endian), bytes
+	uint16_t len = (uint16_t)headSize;
+	uint8_t stored[7] = { (uint8_t)(header >> 8), (uint8_t)header, 0x00,
+		(uint8_t)len, (uint8_t)(len >> 8), (uint8_t)~len, (uint8_t)(~len >> 8) };
+	out.insert(out.end(), stored, stored + sizeof(stored));
+	out.insert(out.end(), head, head + headSize);
+	// the body is a raw deflate stream ending in the final block
+	out.insert(out.end(), compressed.data.begin(), compressed.data.end());
+	uLong headSum = adler32(adler32(0L, Z_NULL, 0), head, (uInt)headSize);
+	uint32_t sum = (uint32_t)adler32_combine(headSum, compressed.checksum, (z_off_t)compressed.inputSize);
+	uint8_t trailer[4] = { (uint8_t)(sum >> 24), (uint8_t)(sum >> 16), (uint8_t)(sum >> 8), (uint8_t)sum };
+	out.insert(out.end(), trailer, trailer + sizeof(trailer));
+}
+
+// zlib: streams each NBT flush through deflate straight into the output vector
+class ZlibCompressor : public ChunkCompressor {
+public:
+	explicit ZlibCompressor(int level): ChunkCompressor(level), out(nullptr) {
+		memset(&zs, 0, sizeof(zs));
+		// raw deflate (negative window bits), frame() wraps it
+		inited = deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+	}
+	~ZlibCompressor() {
+		if (inited) deflateEnd(&zs);
+	}
+	uint8_t anvilType() const override { return 2; }
+
+protected:
+	void start(std::vector<uint8_t>* output) override {
+		out = output;
+		// reset keeps the z_stream's window and hash tables allocated
+		if (inited) deflateReset(&zs);
+	}
+	bool compress(const uint8_t* p, size_t n) override { return pump(p, n, Z_NO_FLUSH); }
+	bool end() override { return pump(nullptr, 0, Z_FINISH); }
+
+private:
+	bool pump(const uint8_t* p, size_t n, int flush) {
+		if (!inited || !out) return false;
+		zs.next_in = const_cast<Bytef*>(p);
+		zs.avail_in = (uInt)n;
+		while (true) {
+			// deflate straight into the tail of the output vector, growing it as needed
+			size_t at = out->size();
+			size_t room = deflateBound(&zs, zs.avail_in) + 64;
+			out->resize(at + room);
+			zs.next_out = out->data() + at;
+			zs.avail_out = (uInt)room;
+			int rv = deflate(&zs, flush);
+			out->resize(at + (room - zs.avail_out));
+			if (rv == Z_STREAM_END) return true;
+			if (rv != Z_OK && rv != Z_BUF_ERROR) return false;
+			if (flush == Z_NO_FLUSH && zs.avail_in == 0) return true;
+		}
+	}
+
+	z_stream zs;
+	bool inited;
+	std::vector<uint8_t>* out;
+};
+
+#ifdef EDEN_HAVE_LIBDEFLATE
+// libdeflate has no streaming API: NBT is collected in a reused buffer and compressed in one call on finish
+class LibdeflateCompressor : public ChunkCompressor {
+public:
+	explicit LibdeflateCompressor(int level): ChunkCompressor(level), out(nullptr) {
+		c = libdeflate_alloc_compressor(level);
+	}
+	~LibdeflateCompressor() {
+		if (c) libdeflate_free_compressor(c);
+	}
+	uint8_t anvilType() const override { return 2; }
+
+protected:
+	void start(std::vector<uint8_t>* output) override {
+		out = output;
+		input.clear();
+	}
+	bool compress(const uint8_t* p, size_t n) override {
+		input.insert(input.end(), p, p + n);
+		return true;
+	}
+	bool end() override {
+		if (!c || !out) return false;
+		size_t at = out->size();
+		size_t bound = libdeflate_deflate_compress_bound(c, input.size());
+		out->resize(at + bound);
+		size_t n = libdeflate_deflate_compress(c, input.data(), input.size(), out->data() + at, bound);
+		out->resize(at + n);
+		return n != 0;
+	}
+
+private:
+	libdeflate_compressor* c;
+	std::vector<uint8_t> input;
+	std::vector<uint8_t>* out;
+};
+#endif
+
+// Anvil type 3: the NBT is stored as is
+class StoredCompressor : public ChunkCompressor {
+public:
+	StoredCompressor(): ChunkCompressor(0), out(nullptr) {}
+	uint8_t anvilType() const override { return 3; }
+
+protected:
+	void start(std::vector<uint8_t>* output) override { out = output; }
+	bool compress(const uint8_t* p, size_t n) override {
+		if (!out) return false;
+		out->insert(out->end(), p, p + n);
+		return true;
+	}
+	bool end() override { return out != nullptr; }
+
+private:
+	std::vector<uint8_t>* out;
+};
+
+ChunkCompressor* ChunkCompressor::create(const CompressionSettings& settings) {
+	switch (settings.kind) {
+	case COMPRESS_ZLIB: return new ZlibCompressor(settings.level);
+#ifdef EDEN_HAVE_LIBDEFLATE
+	case COMPRESS_LIBDEFLATE: return new LibdeflateCompressor(settings.level);
+#endif
+	case COMPRESS_NONE: return new StoredCompressor();
+	default: return nullptr;
+	}
+}
+
+bool compressionAvailable(CompressionKind kind) {
+#ifndef EDEN_HAVE_LIBDEFLATE
+	if (kind == COMPRESS_LIBDEFLATE) return false;
+#endif
+	return kind == COMPRESS_ZLIB || kind == COMPRESS_LIBDEFLATE || kind == COMPRESS_NONE;
+}
+
+const char* compressionName(CompressionKind kind) {
+	switch (kind) {
+	case COMPRESS_LIBDEFLATE: return "libdeflate";
+	case COMPRESS_NONE: return "none";
+	default: return "zlib";
+	}
+}
+
+bool parseCompression(const char* text, CompressionSettings& out) {
+	const char* colon = strchr(text, ':');
+	size_t nameLen = colon ? (size_t)(colon - text) : strlen(text);
+	CompressionSettings s;
+	if (nameLen == 4 && strncmp(text, "zlib", 4) == 0) {
+		s.kind = COMPRESS_ZLIB;
+		s.level = 1;
+	}
+	else if (nameLen == 10 && strncmp(text, "libdeflate", 10) == 0) {
+		s.kind = COMPRESS_LIBDEFLATE;
+		s.level = 1;
+	}
+	else if (nameLen == 4 && strncmp(text, "none", 4) == 0) {
+		s.kind = COMPRESS_NONE;
+		s.level = 0;
+	}
+	else {
+		return false;
+	}
+	if (colon) {
+		s.level = atoi(colon + 1);
+		// libdeflate has no stored level 0; -c none is the uncompressed option
+		int minLevel = s.kind == COMPRESS_LIBDEFLATE ? 1 : 0;
+		int maxLevel = s.kind == COMPRESS_LIBDEFLATE ? 12 : 9;
+		if (s.level < minLevel || s.level > maxLevel) return false;
+	}
+	out = s;
+	return true;
+}
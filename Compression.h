@@ -0,0 +1,68 @@
+#pragma once
+#include "NBT.h"
+#include <cstdint>
+#include <vector>
+
+// Chunk compression backends for region files, selectable at runtime.
+// Each conversion worker creates its own compressor and reuses it for every chunk.
+
+enum CompressionKind {
+	COMPRESS_ZLIB = 0,    // zlib, levels 0-9 (Anvil type 2)
+	COMPRESS_LIBDEFLATE,  // libdeflate, levels 1-12, zlib-compatible output (Anvil type 2)
+	COMPRESS_NONE         // stored uncompressed (Anvil type 3, read by Minecraft 1.15.1 and later)
+};
+
+struct CompressionSettings {
+	CompressionKind kind = COMPRESS_ZLIB;
+	int level = 1; // Z_BEST_SPEED
+};
+
+// Parse "zlib", "zlib:6", "libdeflate:12", "none"; false if the text is not understood
+bool parseCompression(const char* text, CompressionSettings& out);
+const char* compressionName(CompressionKind kind);
+// libdeflate is only available when built with -DEDEN_WITH_LIBDEFLATE, its header was found and
+// -ldeflate is linked
+bool compressionAvailable(CompressionKind kind);
+
+// Compressed NBT of a chunk without its head (see ChunkCompressor::frame). Chunks with the same
+// content but different positions share one body
+struct CompressedBody {
+	std::vector<uint8_t> data;
+	uint32_t checksum = 1; // adler32 of the uncompressed bytes
+	size_t inputSize = 0;
+};
+
+// Compresses one chunk at a time. Used as the sink of an nbt::Buffer, so NBT is
+// compressed while it is being encoded
+class ChunkCompressor : public nbt::Sink {
+public:
+	virtual ~ChunkCompressor() {}
+	// Anvil compression type byte stored in front of the chunk data
+	virtual uint8_t anvilType() const = 0;
+	// Start a chunk body; it replaces the contents of *body
+	void begin(CompressedBody* body);
+	bool write(const uint8_t* p, size_t n) override;
+	// Complete the body; false on any compressor error
+	bool finish();
+
+	// Append the chunk data of an Anvil payload to out: the head bytes stored uncompressed, followed by
+	// a body from a compressor of the same kind. For zlib the head is a stored deflate block in front of
+	// the compressed body, inside one zlib stream, so only the head has to be redone for another chunk
+	void frame(const uint8_t* head, size_t headSize, const CompressedBody& body, std::vector<uint8_t>& out) const;
+
+	// nullptr if the backend isn't available in this build
+	static ChunkCompressor* create(const CompressionSettings& settings);
+
+protected:
+	explicit ChunkCompressor(int level): level(level), body(nullptr) {}
+	// Backend: appends raw deflate (no zlib header or checksum, frame adds those) for type 2,
+	// the input itself for type 3
+	virtual void start(std::vector<uint8_t>* out) = 0;
+	virtual bool compress(const uint8_t* p, size_t n) = 0;
+	virtual bool end() = 0;
+
+	int level;
+
+private:
+	CompressedBody* body;
+};
@@ -0,0 +1,121 @@
+#include "ConversionManifest.h"
+#include <cstdio>
+#include <cstring>
+#include <sys/types.h>
+#include <vector>
+
+// Bump whenever the converter writes a different chunk for the same column, so older
+// manifests stop matching
+static const uint32_t MANIFEST_VERSION = 1;
+static const char MANIFEST_MAGIC[8] = { 'E', 'D', 'N', 'M', 'A', 'N', 'I', 'F' };
+
+// File layout: header, then count records. Native byte order; a manifest moved to a machine of the
+// other byte order just fails to load. Keys are only comparable under the same CONTENT_HASH_VERSION
+struct ManifestHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t hashVersion;
+	int32_t shiftX, shiftZ;
+	uint8_t chunkFormat, lighting, compression;
+	int8_t level;
+	uint64_t count;
+};
+
+struct ManifestRecord {
+	int32_t x, z;
+	uint64_t lo, hi;
+	uint32_t location;
+	uint32_t reserved;
+};
+
+static ManifestHeader headerFor(const ManifestSettings& settings, uint64_t count) {
+	ManifestHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, MANIFEST_MAGIC, sizeof(h.magic));
+	h.version = MANIFEST_VERSION;
+	h.hashVersion = CONTENT_HASH_VERSION;
+	h.shiftX = settings.shiftX;
+	h.shiftZ = settings.shiftZ;
+	h.chunkFormat = settings.chunkFormat;
+	h.lighting = settings.lighting;
+	h.compression = settings.compression;
+	h.level = settings.level;
+	h.count = count;
+	return h;
+}
+
+bool ConversionManifest::load(const std::string& path, const ManifestSettings& settings) {
+	entries.clear();
+	FILE* f = fopen(path.c_str(), "rb");
+	if (!f) return false;
+	ManifestHeader h;
+	ManifestHeader expected = headerFor(settings, 0);
+	bool ok = fread(&h, sizeof(h), 1, f) == 1;
+	expected.count = ok ? h.count : 0;
+	ok = ok && memcmp(&h, &expected, sizeof(h)) == 0;
+	// the count comes from disk: it must fit the file before anything is allocated for it
+	off_t size = -1;
+	if (ok && fseeko(f, 0, SEEK_END) == 0) size = ftello(f);
+	ok = ok && size >= (off_t)sizeof(h) && h.count == (uint64_t)(size - (off_t)sizeof(h)) / sizeof(ManifestRecord);
+	ok = ok && fseeko(f, (off_t)sizeof(h), SEEK_SET) == 0;
+	std::vector<ManifestRecord> records;
+	if (ok) {
+		records.resize((size_t)h.count);
+		ok = records.empty() || fread(records.data(), sizeof(ManifestRecord), records.size(), f) == records.size();
+		ok = ok && fgetc(f) == EOF; // nothing may follow the records
+	}
+	fclose(f);
+	if (!ok) return false;
+	entries.reserve(records.size());
+	for (const ManifestRecord& r : records) {
+		Entry e;
+		e.key.lo = r.lo;
+		e.key.hi = r.hi;
+		e.location = r.location;
+		entries[keyOf(r.x, r.z)] = e;
+	}
+	return true;
+}
+
+bool ConversionManifest::save(const std::string& path, const ManifestSettings& settings) const {
+	std::string tmp = path + ".tmp";
+	FILE* f = fopen(tmp.c_str(), "wb");
+	if (!f) { printf("failed to create %s\n", tmp.c_str()); return false; }
+	ManifestHeader h = headerFor(settings, entries.size());
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+	std::vector<ManifestRecord> records;
+	records.reserve(entries.size());
+	forEach([&](int x, int z, const Entry& e) {
+		ManifestRecord r;
+		memset(&r, 0, sizeof(r));
+		r.x = x;
+		r.z = z;
+		r.lo = e.key.lo;
+		r.hi = e.key.hi;
+		r.location = e.location;
+		records.push_back(r);
+	});
+	ok = ok && (records.empty() || fwrite(records.data(), sizeof(ManifestRecord), records.size(), f) == records.size());
+	ok = fclose(f) == 0 && ok;
+	ok = ok && rename(tmp.c_str(), path.c_str()) == 0;
+	if (!ok) {
+		printf("failed to write %s\n", path.c_str());
+		remove(tmp.c_str());
+	}
+	return ok;
+}
+
+const ConversionManifest::Entry* ConversionManifest::find(int x, int z) const {
+	auto it = entries.find(keyOf(x, z));
+	return it == entries.end() ? nullptr : &it->second;
+}
+
+void ConversionManifest::set(int x, int z, const ContentHash& key, uint32_t location) {
+	Entry& e = entries[keyOf(x, z)];
+	e.key = key;
+	e.location = location;
+}
+
+void ConversionManifest::erase(int x, int z) {
+	entries.erase(keyOf(x, z));
+}
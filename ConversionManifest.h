@@ -0,0 +1,54 @@
+#pragma once
+#include "ChunkCache.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Sidecar of a converted world: for every exported column its Eden position, the content hash it
+// was converted from (see columnKey in EdenFileLoader.cpp) and where its chunk went in the region
+// file. Converting into the same directory again with the same settings only redoes the columns
+// whose hash changed.
+
+// Name of the manifest inside the output world directory
+static const char* const MANIFEST_FILE = "eden_manifest.dat";
+
+// Everything besides column content that changes the output; a manifest written with other
+// settings is ignored
+struct ManifestSettings {
+	int32_t shiftX = 0, shiftZ = 0; // recentering (the player's chunk)
+	uint8_t chunkFormat = 0;
+	uint8_t lighting = 0;
+	uint8_t compression = 0;
+	int8_t level = 0;
+};
+
+class ConversionManifest {
+public:
+	struct Entry {
+		ContentHash key;
+		uint32_t location; // region header entry of the chunk: first sector << 8 | sector count
+	};
+
+	// Replace the contents with the manifest at path; false (and empty) if it is missing,
+	// damaged or was written with other settings
+	bool load(const std::string& path, const ManifestSettings& settings);
+
+	// Write to path.tmp and rename it over path, so a crash never leaves half a manifest
+	bool save(const std::string& path, const ManifestSettings& settings) const;
+
+	// Entry of Eden column (x,z), or nullptr
+	const Entry* find(int x, int z) const;
+	void set(int x, int z, const ContentHash& key, uint32_t location);
+	void erase(int x, int z);
+	size_t size() const { return entries.size(); }
+
+	// Call fn(x, z, entry) for every column
+	template <typename Fn>
+	void forEach(Fn fn) const {
+		for (const auto& kv : entries) fn((int)(kv.first >> 32), (int)(uint32_t)kv.first, kv.second);
+	}
+
+private:
+	static long long keyOf(int x, int z) { return ((long long)x << 32) ^ (long long)(uint32_t)z; }
+	std::unordered_map<long long, Entry> entries;
+};
@@ -1,39 +1,92 @@
 
 #include "EdenFileLoader.h"
 #include "AnvilWriter.h"
-#include "BlockMap.h"
+#include "ChunkCache.h"
+#include "ConversionManifest.h"
+#include "EdenMappedFile.h"
+#include "LightEngine.h"
+#include "Profiler.h"
+#include "SectionPack.h"
 #include <unistd.h>
 #include <limits.h>
+#include <sys/stat.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 
-FILE* fp = NULL;
-WorldFileHeader* sfh = NULL;
-
 using namespace std;
-int num_columns = 0;
-vector<ColumnIndex*> colindexes;
+
+EdenFileLoader::EdenFileLoader(): useMmap(true), mapped(new EdenMappedFile()), threadCount(0), crashSafe(false), regionIO(REGION_IO_AUTO), maxOpenRegions(256), lighting(true), dedup(true), chunkFormat(CHUNK_FORMAT_1_12), profile(false), incremental(true),
+	fp(NULL), sfh(NULL), num_columns(0) {}
+
+EdenFileLoader::~EdenFileLoader() {
+	free(sfh);
+	delete mapped;
+}
+
+bool EdenFileLoader::openMapping(const char* path) {
+	mapped->close();
+	if (!useMmap) return false;
+	return mapped->open(path);
+}
+
+// Bounds check a column before seeking to it, chunk_offset comes straight from the file
+static bool columnInFile(const ColumnIndex* ci, unsigned long long fileSize) {
+	return ci->chunk_offset <= fileSize && fileSize - ci->chunk_offset >= COLUMN_BYTES_IN_FILE;
+}
+
+static unsigned long long fileSizeOf(FILE* f) {
+	struct stat st;
+	if (fstat(fileno(f), &st) != 0) return 0;
+	return (unsigned long long)st.st_size;
+}
+
+// Load the whole trailing directory in one go (a single copy out of the mapping, or one fread)
+// into a flat array in directory order
 void  EdenFileLoader::readDirectory() {
 
+	colindexes.clear();
 	num_columns = 0;
-	int rn = fseek(fp, (long int)sfh->directory_offset, SEEK_SET);
 
-	if (rn != 0)printf("seek to directory offset failed");
+	unsigned long long fileSize = mapped->isOpen() ? mapped->size() : fileSizeOf(fp);
+	unsigned long long dirOffset = sfh->directory_offset;
+	if (dirOffset > fileSize) {
+		printf("directory offset %llu is past end of file (%llu bytes)\n", dirOffset, fileSize);
+		lookup.reset(0);
+		return;
+	}
+	size_t count = (size_t)((fileSize - dirOffset) / sizeof(ColumnIndex));
+	colindexes.resize(count);
 
-	while (true) {
-		ColumnIndex* colIdx = (ColumnIndex*)malloc(sizeof(ColumnIndex));
-		if (!colIdx)return;
+	if (mapped->isOpen()) {
+		const uint8_t* dir = mapped->range(dirOffset, count * sizeof(ColumnIndex));
+		if (dir && count) memcpy(colindexes.data(), dir, count * sizeof(ColumnIndex));
+	}
+	else {
+		// fseeko: offsets in shared world archives go past what a long can hold on some platforms
+		int rn = fseeko(fp, (off_t)dirOffset, SEEK_SET);
 
-    int nr = fread(colIdx, sizeof(ColumnIndex), 1, fp);
-    if (nr != 1) {
-			break;
-		}
-		colindexes.push_back(colIdx);
-		num_columns++;
+		if (rn != 0)printf("seek to directory offset failed");
+		size_t nr = count ? fread(colindexes.data(), sizeof(ColumnIndex), count, fp) : 0;
+		colindexes.resize(nr);
+		count = nr;
 	}
+
+	num_columns = (int)count;
 	printf("read in column_directory_indexes, numcolumns: %d \n ", num_columns);
 
+	// a duplicated (x,z) resolves to its first directory entry
+	lookup.reset(num_columns);
+	for (int i = 0; i < num_columns; i++) lookup.insert(colindexes[i].x, colindexes[i].z, i);
 }
 block8* blockarray = NULL;
 color8* colorarray = NULL;
@@ -45,40 +98,54 @@ int chunkOffsetZ;
 block8 chunk_block_array[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
 color8 chunk_color_array[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
 
-#define CHUNKS_PER_COLUMN_IN_FILE 4
 bool EdenFileLoader::readColumn(int cx, int cz) {
 
 
-	int idx = -1;
-	for (int i = 0; i < num_columns; i++) {
-		if (colindexes[i]->x == cx && colindexes[i]->z == cz) {
-			idx = i;
-			break;
-		}
-	}
+	int idx = lookup.find(cx, cz);
 	if (idx == -1)return false;
 
-	int rn = fseek(fp, (long int)colindexes[idx]->chunk_offset, SEEK_SET);
+	ColumnView view;
+	if (mapped->isOpen()) {
+		if (!mapped->column(colindexes[idx], view)) {
+			printf("column %d, %d lies outside the file\n", cx, cz);
+			return false;
+		}
+	}
+	else {
+		if (!columnInFile(&colindexes[idx], fileSizeOf(fp))) {
+			printf("column %d, %d lies outside the file\n", cx, cz);
+			return false;
+		}
+		int rn = fseeko(fp, (off_t)colindexes[idx].chunk_offset, SEEK_SET);
 
-	if (rn != 0) {
-		printf("seek to directory offset failed\n");
-		return false;
+		if (rn != 0) {
+			printf("seek to directory offset failed\n");
+			return false;
+		}
 	}
 	int adj_cx = cx - chunkOffsetX;
 	int  adj_cz = cz - chunkOffsetZ;
 	printf("loading column %d, %d \n", adj_cx, adj_cz);
 	for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) {
 
-    int nr = fread(chunk_block_array, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * sizeof(block8), 1, fp);
-    if (nr != 1) {
-			printf("read blocks failed %d, %d\n", cx, cz);
-			return false;
+		const block8* chunk_blocks = chunk_block_array;
+		const color8* chunk_colors = chunk_color_array;
+		if (mapped->isOpen()) {
+			chunk_blocks = view.blocks[cy];
+			chunk_colors = view.colors[cy];
 		}
+		else {
+			int nr = fread(chunk_block_array, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * sizeof(block8), 1, fp);
+			if (nr != 1) {
+				printf("read blocks failed %d, %d\n", cx, cz);
+				return false;
+			}
 
-    nr = fread(chunk_color_array, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * sizeof(color8), 1, fp);
-    if (nr != 1) {
-			printf("read colors failed %d, %d\n", cx, cz);
-			return false;
+			nr = fread(chunk_color_array, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * sizeof(color8), 1, fp);
+			if (nr != 1) {
+				printf("read colors failed %d, %d\n", cx, cz);
+				return false;
+			}
 		}
 
 
@@ -89,12 +156,12 @@ bool EdenFileLoader::readColumn(int cx, int cz) {
 				//copy data to global block and color array's, becareful to avoid memory corruption
 
 					GBLOCK(adj_cx * CHUNK_SIZE + x, adj_cz * CHUNK_SIZE + z, cy * CHUNK_SIZE + y) =
-						chunk_block_array[x * CHUNK_SIZE * CHUNK_SIZE + z * CHUNK_SIZE + y];
+						chunk_blocks[x * CHUNK_SIZE * CHUNK_SIZE + z * CHUNK_SIZE + y];
 
 
 					
 					GCOLOR(adj_cx * CHUNK_SIZE + x, adj_cz * CHUNK_SIZE + z, cy * CHUNK_SIZE + y) =
-					chunk_color_array[x * CHUNK_SIZE * CHUNK_SIZE + z * CHUNK_SIZE + y];
+					chunk_colors[x * CHUNK_SIZE * CHUNK_SIZE + z * CHUNK_SIZE + y];
 				}
 
 			}
@@ -127,6 +194,7 @@ void EdenFileLoader::loadWorld(char* name) {
 		printf("failed to open file: %s\n", name);
 		return;
 	}
+	free(sfh);
 	sfh = (WorldFileHeader*)malloc(sizeof(WorldFileHeader));
 	if (!sfh)return;
 	fread(sfh, sizeof(WorldFileHeader), 1, fp);
@@ -135,7 +203,7 @@ void EdenFileLoader::loadWorld(char* name) {
 		sfh->home.x, sfh->home.y, sfh->home.z);
 	printf(" chunk_directory_offset: %ld  \n", (long)sfh->directory_offset);
 
-
+	openMapping(name);
 	this->readDirectory();
 
 
@@ -156,14 +224,317 @@ void EdenFileLoader::loadWorld(char* name) {
 	}
 	printf("loaded n_columns: %d  out of %d \n", ncol_loaded, r * 2 * r * 2);
 
-
+	mapped->close();
 	fclose(fp);
+	fp = NULL;
+
+
+}
+
+
+// Scratch state owned by one conversion worker, reused for every column it converts
+struct ColumnWorker {
+	block8 blocks[CHUNKS_PER_COLUMN_IN_FILE][CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+	color8 colors[CHUNKS_PER_COLUMN_IN_FILE][CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+	ColumnSections sections;
+	CompressedBody body;
+	int32_t heightMap[CHUNK_SIZE * CHUNK_SIZE];
+	LightEngine lightEngine;
+	ColumnLight light;
+	block8 halo[8][CHUNKS_PER_COLUMN_IN_FILE][CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE]; // neighbour blocks when reading with pread
+};
+
+// A column encoded by a worker, waiting for the writer stage. An empty payload is an
+// all-air column: nothing is written, but the writer still counts it for its region.
+// An unchanged column (same key as in the previous conversion's manifest) has no payload either;
+// its chunk is already in the region file
+struct EncodedColumn {
+	int cx, cz;
+	bool unchanged;
+	bool failed; // could not be read or encoded: nothing to write, the run is incomplete
+	ContentHash key;
+	std::vector<uint8_t> payload;
+};
+
+// Bounded hand-off from the conversion workers to the single region writer. A fixed ring, so
+// passing a column along never allocates
+class EncodedQueue {
+public:
+	EncodedQueue(size_t capacity, int producers): ring(capacity), head(0), count(0), producersLeft(producers) {}
+
+	void push(EncodedColumn&& col) {
+		unique_lock<mutex> lock(m);
+		notFull.wait(lock, [&] { return count < ring.size(); });
+		ring[(head + count) % ring.size()] = std::move(col);
+		count++;
+		notEmpty.notify_one();
+	}
+
+	// Blocks until a column is ready; false once every producer is done and the queue is drained
+	bool pop(EncodedColumn& col) {
+		unique_lock<mutex> lock(m);
+		notEmpty.wait(lock, [&] { return count != 0 || producersLeft == 0; });
+		if (count == 0) return false;
+		col = std::move(ring[head]);
+		head = (head + 1) % ring.size();
+		count--;
+		notFull.notify_one();
+		return true;
+	}
+
+	void producerDone() {
+		lock_guard<mutex> lock(m);
+		producersLeft--;
+		notEmpty.notify_all();
+	}
+
+	// The writer hands written payloads back so workers reuse their (sector aligned) memory
+	void recycle(vector<uint8_t>&& payload) {
+		lock_guard<mutex> lock(m);
+		spares.push_back(std::move(payload));
+	}
+
+	void takeSpare(vector<uint8_t>& payload) {
+		lock_guard<mutex> lock(m);
+		if (spares.empty()) return;
+		payload = std::move(spares.back());
+		spares.pop_back();
+	}
+
+private:
+	mutex m;
+	condition_variable notFull, notEmpty;
+	vector<EncodedColumn> ring;
+	size_t head, count;
+	vector<vector<uint8_t>> spares;
+	int producersLeft;
+};
+
+// Map every voxel of one column to MC id+data and pack it into the worker's sections (packSection
+// overwrites every byte). All-air sections are detected on the raw Eden bytes and never packed. Returns the number of
+// sections that hold blocks. The HeightMap is built here too, while the sections are still in cache
+static int packColumn(const ColumnView& view, ColumnWorker& w) {
+	int present = 0;
+	for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) {
+		w.sections.present[cy] = !sectionIsAir(view.blocks[cy]);
+		if (!w.sections.present[cy]) continue;
+		packSection(view.blocks[cy], w.sections.blocks[cy], w.sections.data[cy]);
+		present++;
+	}
+	if (present) {
+		const uint8_t* packed[CHUNKS_PER_COLUMN_IN_FILE];
+		for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) packed[cy] = w.sections.present[cy] ? w.sections.blocks[cy] : nullptr;
+		buildHeightMap(packed, CHUNKS_PER_COLUMN_IN_FILE, w.heightMap);
+	}
+	return present;
+}
+
+// Fetch a column's chunks, either as views into the mapping or with pread into the worker's buffers.
+// pread keeps no shared file position, so workers can read the same FILE* concurrently
+static bool fetchColumn(const ColumnIndex& ci, const EdenMappedFile* mapped, int fd, ColumnWorker& w, ColumnView& view) {
+	if (mapped) return mapped->column(ci, view);
+
+	off_t off = (off_t)ci.chunk_offset;
+	for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) {
+		ssize_t nr = pread(fd, w.blocks[cy], sizeof(w.blocks[cy]), off);
+		if (nr != (ssize_t)sizeof(w.blocks[cy])) { printf("read blocks failed %d,%d\n", ci.x, ci.z); return false; }
+		off += sizeof(w.blocks[cy]);
+		nr = pread(fd, w.colors[cy], sizeof(w.colors[cy]), off);
+		if (nr != (ssize_t)sizeof(w.colors[cy])) { printf("read colors failed %d,%d\n", ci.x, ci.z); return false; }
+		off += sizeof(w.colors[cy]);
+		view.blocks[cy] = w.blocks[cy];
+		view.colors[cy] = w.colors[cy];
+	}
+	return true;
+}
+
+// Hash of a column's Eden block ids; colors never reach the output
+static ContentHash blocksHash(const ColumnView& view) {
+	ContentHasher h;
+	for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) h.update(view.blocks[cy], CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE);
+	return h.digest();
+}
+
+// blocksHash of every column by directory position, computed at most once and shared by the
+// workers: with lighting each column is part of nine neighbourhoods
+class ColumnHashes {
+public:
+	explicit ColumnHashes(size_t n): hashes(n), state(n) {}
+
+	ContentHash get(int index, const ColumnView& view) {
+		if (state[index].load(memory_order_acquire) == READY) return hashes[index];
+		ContentHash h = blocksHash(view);
+		// the first worker to finish publishes it, any other just uses its own copy
+		uint8_t expected = EMPTY;
+		if (state[index].compare_exchange_strong(expected, BUSY)) {
+			hashes[index] = h;
+			state[index].store(READY, memory_order_release);
+		}
+		return h;
+	}
+
+private:
+	enum { EMPTY = 0, BUSY, READY };
+	vector<ContentHash> hashes;
+	vector<atomic<uint8_t>> state;
+};
+
+// Cache key of a column: its blocks and, when it is lit, the blocks of the neighbours its light
+// depends on (hood = nullptr when not lighting, hashes is only needed with hood)
+static ContentHash columnKey(const ColumnIndex& ci, int index, const ColumnView& view, const ColumnView* const hood[3][3],
+	const ColumnLookup& lookup, ColumnHashes* hashes) {
+	if (!hood) return blocksHash(view);
+	ContentHasher h;
+	ContentHash own = hashes->get(index, view);
+	h.update(&own, sizeof(own));
+	uint16_t there = 0;
+	for (int n = 0; n < 9; n++) {
+		const ColumnView* v = hood[n / 3][n % 3];
+		if (n == 4 || !v) continue;
+		there |= (uint16_t)(1 << n);
+		ContentHash nh = hashes->get(lookup.find(ci.x + n / 3 - 1, ci.z + n % 3 - 1), *v);
+		h.update(&nh, sizeof(nh));
+	}
+	h.update(&there, sizeof(there));
+	return h.digest();
+}
+
+// Target region of a recentered chunk coordinate (arithmetic shift floors negatives)
+static inline long long regionKeyOf(int cx, int cz) {
+	return ((long long)(cx >> 5) << 32) ^ (long long)((cz >> 5) & 0xffffffff);
+}
+
+// Inclusive rectangle of Eden chunk coordinates
+struct ChunkBox {
+	int minX, minZ, maxX, maxZ;
+	bool contains(int x, int z) const { return x >= minX && x <= maxX && z >= minZ && z <= maxZ; }
+	long long area() const {
+		if (maxX < minX || maxZ < minZ) return 0;
+		return ((long long)maxX - minX + 1) * ((long long)maxZ - minZ + 1);
+	}
+};
+
+// The columns area selects; false if it is the whole world
+static bool areaBox(const ConversionArea& area, const WorldFileHeader* sfh, int shiftX, int shiftZ, ChunkBox& box) {
+	if (area.kind == AREA_ALL) return false;
+	if (area.kind == AREA_BOX) {
+		box.minX = area.minX + shiftX;
+		box.minZ = area.minZ + shiftZ;
+		box.maxX = area.maxX + shiftX;
+		box.maxZ = area.maxZ + shiftZ;
+		return true;
+	}
+	// centre chunk as for recentering, radius chunks on every side of it
+	const Vector& centre = area.kind == AREA_HOME ? sfh->home : sfh->pos;
+	int cx = (int)(centre.x / CHUNK_SIZE);
+	int cz = (int)(centre.z / CHUNK_SIZE);
+	box.minX = cx - area.radius;
+	box.minZ = cz - area.radius;
+	box.maxX = cx + area.radius;
+	box.maxZ = cz + area.radius;
+	return true;
+}
+
+// Conversion order: positions in colindexes grouped by target region (after recentering), then by
+// offset in the Eden file, so each region is produced in one burst and reads stream forward.
+// Duplicate directory entries are dropped, the first one wins as in readColumn. With a box only
+// the columns inside it are scheduled.
+// regionColumns receives the number of scheduled columns per region
+static vector<int> scheduleColumns(const vector<ColumnIndex>& cols, const ColumnLookup& lookup, const ChunkBox* box, int shiftX, int shiftZ,
+	unordered_map<long long, int>& regionColumns) {
+	struct Entry { long long region; unsigned long long offset; int index; };
+	vector<Entry> entries;
+	auto add = [&](int i) {
+		const ColumnIndex& ci = cols[i];
+		Entry e;
+		e.region = regionKeyOf(ci.x - shiftX, ci.z - shiftZ);
+		e.offset = ci.chunk_offset;
+		e.index = i;
+		entries.push_back(e);
+	};
+	if (box && box->area() < (long long)cols.size()) {
+		// a box smaller than the world: probe its positions instead of walking the directory
+		lookup.forEachInBox(box->minX, box->minZ, box->maxX, box->maxZ, [&](int, int, int idx) { add(idx); });
+	}
+	else {
+		entries.reserve(cols.size());
+		for (size_t i = 0; i < cols.size(); i++) {
+			const ColumnIndex& ci = cols[i];
+			if (lookup.find(ci.x, ci.z) != (int)i) continue;
+			if (box && !box->contains(ci.x, ci.z)) continue;
+			add((int)i);
+		}
+	}
+	sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+		if (a.region != b.region) return a.region < b.region;
+		return a.offset < b.offset;
+	});
+	vector<int> order(entries.size());
+	regionColumns.clear();
+	for (size_t k = 0; k < entries.size(); k++) {
+		order[k] = entries[k].index;
+		regionColumns[entries[k].region]++;
+	}
+	return order;
+}
 
+// Views of the 3x3 columns around ci for the light engine (centre = view, nullptr where the world
+// has no column). Only block arrays are needed, so with pread the colors are not read
+static void fetchNeighborhood(const ColumnIndex& ci, const ColumnView& view, const vector<ColumnIndex>& cols, const ColumnLookup& lookup,
+	const EdenMappedFile* mapped, int fd, unsigned long long fileSize, ColumnWorker& w, ColumnView views[3][3], const ColumnView* hood[3][3]) {
+	int k = 0;
+	for (int dx = -1; dx <= 1; dx++) {
+		for (int dz = -1; dz <= 1; dz++) {
+			const ColumnView*& slot = hood[dx + 1][dz + 1];
+			if (dx == 0 && dz == 0) { slot = &view; continue; }
+			slot = nullptr;
+			block8 (*buf)[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE] = w.halo[k++];
+			int idx = lookup.find(ci.x + dx, ci.z + dz);
+			if (idx < 0 || !columnInFile(&cols[idx], fileSize)) continue;
+			Profiler::count(COUNTER_BYTES_READ, sizeof(w.blocks));
+			ColumnView& v = views[dx + 1][dz + 1];
+			if (mapped) {
+				if (mapped->column(cols[idx], v)) slot = &v;
+				continue;
+			}
+			bool ok = true;
+			for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE && ok; cy++) {
+				off_t off = (off_t)(cols[idx].chunk_offset + (unsigned long long)cy * (sizeof(w.blocks[cy]) + sizeof(w.colors[cy])));
+				ok = pread(fd, buf[cy], sizeof(buf[cy]), off) == (ssize_t)sizeof(buf[cy]);
+				v.blocks[cy] = buf[cy];
+				v.colors[cy] = nullptr;
+			}
+			if (ok) slot = &v;
+		}
+	}
+}
 
+// Forget manifest entries whose chunk is no longer where the manifest says (region file replaced,
+// edited or deleted since), so those columns are converted again. Returns how many were dropped
+static int dropStaleEntries(ConversionManifest& manifest, const AnvilWriter& writer, int shiftX, int shiftZ) {
+	unordered_map<long long, vector<uint32_t>> tables; // location table per region, empty if unreadable
+	vector<pair<int, int>> stale;
+	manifest.forEach([&](int x, int z, const ConversionManifest::Entry& e) {
+		int cx = x - shiftX, cz = z - shiftZ;
+		long long region = regionKeyOf(cx, cz);
+		auto it = tables.find(region);
+		if (it == tables.end()) {
+			vector<uint32_t> table(1024);
+			if (!writer.storedLocations(cx >> 5, cz >> 5, table.data())) table.clear();
+			it = tables.emplace(region, std::move(table)).first;
+		}
+		if (it->second.empty() || it->second[(cx & 31) + (cz & 31) * 32] != e.location) stale.push_back(make_pair(x, z));
+	});
+	for (auto& p : stale) manifest.erase(p.first, p.second);
+	return (int)stale.size();
 }
 
+// Upper bound on compressed bodies kept for reuse; repetitive worlds need far less
+static const size_t DEDUP_CACHE_BYTES = 64 << 20;
 
-// Convert full world: iterate all ColumnIndex entries and export as Anvil chunks
+// Convert full world: iterate all ColumnIndex entries and export as Anvil chunks.
+// Columns are converted region by region (see scheduleColumns). Workers read, map, pack, NBT-encode and compress columns in parallel; the calling thread is the
+// single writer stage and owns every region file
 void EdenFileLoader::convertToMinecraft(const char* edenPath, const char* outputWorldDir) {
 	char cwd[FILENAME_MAX];
 	if (getcwd(cwd, sizeof(cwd)) != NULL) {
@@ -175,86 +546,304 @@ void EdenFileLoader::convertToMinecraft(const char* edenPath, const char* output
 		printf("failed to open file: %s\n", edenPath);
 		return;
 	}
+	free(sfh);
 	sfh = (WorldFileHeader*)malloc(sizeof(WorldFileHeader));
 	if (!sfh) { fclose(fp); return; }
 	fread(sfh, sizeof(WorldFileHeader), 1, fp);
 	printf("Converting file: %s (version %d)\n", sfh->name, sfh->version);
 	printf("Chunk directory at: %ld\n", (long)sfh->directory_offset);
 
-	colindexes.clear();
+	bool useMapping = openMapping(edenPath);
 	this->readDirectory();
+	unsigned long long fileSize = useMapping ? mapped->size() : fileSizeOf(fp);
+
+	if (!compressionAvailable(compression.kind)) {
+		printf("%s compression is not available in this build, using zlib\n", compressionName(compression.kind));
+		compression = CompressionSettings();
+	}
+	printf("Compressing %s chunks with %s level %d\n", chunkFormatName(chunkFormat), compressionName(compression.kind), compression.level);
+
+	int nthreads = threadCount > 0 ? threadCount : (int)thread::hardware_concurrency();
+	if (nthreads < 1) nthreads = 1;
+	printf("Reading columns via %s, converting with %d worker thread(s), %s section packing, lighting %s\n",
+		useMapping ? "mmap" : "pread", nthreads, sectionPackKernelName(bestSectionPackKernel()), lighting ? "on" : "off");
 
     AnvilWriter writer{std::string(outputWorldDir)};
+    writer.setCrashSafe(crashSafe);
+    writer.setIO(regionIO, 2);
+    writer.setMaxOpenRegions(maxOpenRegions > 0 ? (size_t)maxOpenRegions : 0);
+    printf("Writing regions with %s I/O\n", regionIOBackendName(writer.ioBackend()));
 
     // Place the Eden player's column at Minecraft chunk (0,0)
     int playerChunkX = (int)(sfh->pos.x / CHUNK_SIZE);
     int playerChunkZ = (int)(sfh->pos.z / CHUNK_SIZE);
     printf("Recenter: subtracting player chunk (%d,%d) from all chunks.\n", playerChunkX, playerChunkZ);
 
-    int exported = 0;
-    int minCX =  1000000000, minCZ =  1000000000;
-    int maxCX = -1000000000, maxCZ = -1000000000;
-	for (int i = 0; i < num_columns; ++i) {
-		int cx = colindexes[i]->x;
-		int cz = colindexes[i]->z;
-		int rn = fseek(fp, (long int)colindexes[i]->chunk_offset, SEEK_SET);
-		if (rn != 0) {
-			printf("seek to column failed for %d,%d\n", cx, cz);
-			continue;
-		}
+	ChunkBox box;
+	bool limited = areaBox(area, sfh, playerChunkX, playerChunkZ, box);
+	unordered_map<long long, int> regionColumns;
+	vector<int> schedule = scheduleColumns(colindexes, lookup, limited ? &box : nullptr, playerChunkX, playerChunkZ, regionColumns);
+	int scheduled = (int)schedule.size();
+	if (lookup.size() != num_columns) printf("Skipping %d duplicate directory entries\n", num_columns - lookup.size());
+	if (limited) {
+		printf("Converting chunks X:[%d..%d] Z:[%d..%d] only: %d of %d columns in %d region(s)\n", box.minX - playerChunkX, box.maxX - playerChunkX,
+			box.minZ - playerChunkZ, box.maxZ - playerChunkZ, scheduled, lookup.size(), (int)regionColumns.size());
+	}
 
-		// Read 4 vertical chunks in this column and assemble 4 sections (Y=0..3)
-		std::vector<std::vector<uint8_t>> sectionsBlocks(4);
-		std::vector<std::vector<uint8_t>> sectionsData(4);
-		for (int s = 0; s < 4; ++s) {
-			sectionsBlocks[s].assign(CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE, 0);
-			sectionsData[s].assign((CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE)/2, 0);
-		}
+	// A previous conversion into this directory with the same settings: its unchanged columns are kept
+	ManifestSettings manifestSettings;
+	manifestSettings.shiftX = playerChunkX;
+	manifestSettings.shiftZ = playerChunkZ;
+	manifestSettings.chunkFormat = (uint8_t)chunkFormat;
+	manifestSettings.lighting = lighting ? 1 : 0;
+	manifestSettings.compression = (uint8_t)compression.kind;
+	manifestSettings.level = (int8_t)compression.level;
+	string manifestPath = string(outputWorldDir) + "/" + MANIFEST_FILE;
+	ConversionManifest previous, current;
+	bool updating = false; // existing region files are kept and written into
+	if (incremental && previous.load(manifestPath, manifestSettings)) {
+		int stale = dropStaleEntries(previous, writer, playerChunkX, playerChunkZ);
+		printf("Updating the previous conversion: %d columns on record", (int)previous.size());
+		if (stale) printf(", %d more whose chunks were changed or removed since", stale);
+		printf("\n");
+		writer.setUpdateExisting(true);
+		updating = true;
+	}
+	else if (limited) {
+		// regions the area touches also hold chunks outside it: never start them over
+		writer.setUpdateExisting(true);
+		updating = true;
+		printf("No usable manifest of a previous conversion: chunks outside the area keep whatever their region files hold\n");
+	}
+	// regions are about to change; if this run stops early the next one starts from scratch
+	remove(manifestPath.c_str());
+
+	EncodedQueue queue((size_t)nthreads * 4, nthreads);
+	atomic<int> nextColumn(0);
+	unique_ptr<ChunkCache> cache(dedup ? new ChunkCache(DEDUP_CACHE_BYTES) : nullptr);
+	unique_ptr<ColumnHashes> hashes(lighting ? new ColumnHashes(colindexes.size()) : nullptr);
+	atomic<int> reused(0);
+	const EdenMappedFile* source = useMapping ? mapped : nullptr;
+	int fd = fileno(fp);
+
+	bool profiling = profile || !tracePath.empty();
+	if (profiling) {
+		Profiler::start(!tracePath.empty());
+		Profiler::nameThread("writer");
+	}
+
+	auto push = [&](EncodedColumn&& out) {
+		ProfileScope scope(STAGE_QUEUE_WAIT);
+		queue.push(std::move(out));
+	};
+	auto worker = [&](int id) {
+		char name[32];
+		snprintf(name, sizeof(name), "worker %d", id);
+		Profiler::nameThread(name);
+		unique_ptr<ColumnWorker> w(new ColumnWorker());
+		unique_ptr<ChunkCompressor> compressor(ChunkCompressor::create(compression));
+		for (int i = nextColumn++; i < scheduled; i = nextColumn++) {
+			const ColumnIndex& ci = colindexes[schedule[i]];
+			// Write chunk recentered around origin
+			EncodedColumn out;
+			out.cx = ci.x - playerChunkX;
+			out.cz = ci.z - playerChunkZ;
+			out.unchanged = false;
+			out.failed = false;
+			out.key = ContentHash();
+			// failures still reach the writer, which reports them
+			auto fail = [&] {
+				out.failed = true;
+				push(std::move(out));
+			};
+			if (!columnInFile(&ci, fileSize)) {
+				printf("column %d,%d lies outside the file, skipping\n", ci.x, ci.z);
+				fail();
+				continue;
+			}
+			ColumnView view;
+			bool fetched;
+			{
+				ProfileScope scope(STAGE_READ);
+				fetched = fetchColumn(ci, source, fd, *w, view);
+			}
+			if (!fetched) {
+				fail();
+				continue;
+			}
+			Profiler::count(COUNTER_COLUMNS, 1);
+			Profiler::count(COUNTER_BYTES_READ, COLUMN_BYTES_IN_FILE);
+			int present;
+			{
+				ProfileScope scope(STAGE_PACK);
+				present = packColumn(view, *w);
+			}
 
-		for (int cy = 0; cy < 4; cy++) {
-            int nr = fread(chunk_block_array, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * sizeof(block8), 1, fp);
-            if (nr != 1) { printf("read blocks failed %d,%d\n", cx, cz); break; }
-            nr = fread(chunk_color_array, CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * sizeof(color8), 1, fp);
-            if (nr != 1) { printf("read colors failed %d,%d\n", cx, cz); break; }
-
-			// Map each voxel to MC id+data and pack into section arrays
-			for (int x = 0; x < CHUNK_SIZE; x++) {
-				for (int z = 0; z < CHUNK_SIZE; z++) {
-					for (int y = 0; y < CHUNK_SIZE; y++) {
-						int idx = x * CHUNK_SIZE * CHUNK_SIZE + z * CHUNK_SIZE + y;
-						block8 bid = chunk_block_array[idx];
-						color8 col = chunk_color_array[idx];
-						uint8_t mcId=0, mcData=0;
-						bool place = mapEdenToMinecraft(bid, col, mcId, mcData);
-						int secIndex = cy;
-						int voxelIndex = (y * CHUNK_SIZE + z) * CHUNK_SIZE + x; // Y,Z,X order expected by Anvil arrays
-						if (place) {
-							sectionsBlocks[secIndex][voxelIndex] = mcId;
-						} else {
-							sectionsBlocks[secIndex][voxelIndex] = 0; // air
-						}
-						// pack 4-bit data
-						int nibbleIdx = voxelIndex >> 1;
-						bool low = (voxelIndex & 1) == 0;
-						uint8_t& nib = sectionsData[secIndex][nibbleIdx];
-						if (low) nib = (nib & 0xF0) | (mcData & 0x0F); else nib = (nib & 0x0F) | ((mcData & 0x0F) << 4);
-					}
+			if (present == 0) {
+				push(std::move(out));
+				continue;
+			}
+			ColumnView views[3][3];
+			const ColumnView* hood[3][3];
+			if (lighting) {
+				ProfileScope scope(STAGE_READ);
+				fetchNeighborhood(ci, view, colindexes, lookup, source, fd, fileSize, *w, views, hood);
+			}
+			// the key stands for everything the chunk is made from: it finds the column's previous
+			// conversion, goes into the manifest and finds identical columns converted earlier
+			{
+				ProfileScope scope(STAGE_DEDUP);
+				out.key = columnKey(ci, schedule[i], view, lighting ? hood : nullptr, lookup, hashes.get());
+			}
+			const ConversionManifest::Entry* before = previous.find(ci.x, ci.z);
+			if (before && before->key == out.key) {
+				out.unchanged = true;
+				push(std::move(out));
+				continue;
+			}
+			queue.takeSpare(out.payload);
+			// the same content gives the same body: reuse it and only frame the new position
+			shared_ptr<const CompressedBody> cached;
+			if (cache) {
+				ProfileScope scope(STAGE_DEDUP);
+				cached = cache->find(out.key);
+			}
+			if (cached) {
+				{
+					ProfileScope scope(STAGE_ENCODE);
+					AnvilWriter::framePayload(out.cx, out.cz, *cached, *compressor, out.payload);
 				}
+				reused++;
+				push(std::move(out));
+				continue;
+			}
+			if (lighting) {
+				ProfileScope scope(STAGE_LIGHT);
+				w->lightEngine.compute(hood, w->light);
+			}
+			bool encoded;
+			{
+				ProfileScope scope(STAGE_ENCODE);
+				encoded = AnvilWriter::encodeBody(w->sections, w->heightMap, lighting ? &w->light : nullptr, chunkFormat, *compressor, w->body);
+			}
+			if (!encoded) {
+				printf("encoding failed for %d,%d\n", ci.x, ci.z);
+				fail();
+				continue;
 			}
+			Profiler::count(COUNTER_NBT_BYTES, w->body.inputSize);
+			Profiler::count(COUNTER_COMPRESSED_BYTES, w->body.data.size());
+			if (cache) {
+				ProfileScope scope(STAGE_DEDUP);
+				cache->insert(out.key, w->body);
+			}
+			{
+				ProfileScope scope(STAGE_ENCODE);
+				AnvilWriter::framePayload(out.cx, out.cz, w->body, *compressor, out.payload);
+			}
+			push(std::move(out));
 		}
+		queue.producerDone();
+	};
+	vector<thread> workers;
+	for (int t = 0; t < nthreads; t++) workers.emplace_back(worker, t);
 
-        // Write chunk recentered around origin
-        int outCX = cx - playerChunkX;
-        int outCZ = cz - playerChunkZ;
-        writer.writeChunk(outCX, outCZ, sectionsBlocks, sectionsData);
-        if (outCX < minCX) minCX = outCX; if (outCX > maxCX) maxCX = outCX;
-        if (outCZ < minCZ) minCZ = outCZ; if (outCZ > maxCZ) maxCZ = outCZ;
-		exported++;
-		if (exported % 128 == 0) printf("Exported %d chunks...\n", exported);
+    int exported = 0;
+    int skippedAir = 0;
+    int kept = 0, removed = 0;
+    int failed = 0;
+    int minCX =  1000000000, minCZ =  1000000000;
+    int maxCX = -1000000000, maxCZ = -1000000000;
+	// once every column of a region is written it is finished and closed right away. When updating,
+	// chunks an earlier conversion left at positions in the area that have no column now go first
+	auto release = [&](int cx, int cz) {
+		int rx = cx >> 5, rz = cz >> 5;
+		if (updating) {
+			for (int i = 0; i < 1024; i++) {
+				int x = rx * 32 + (i & 31) + playerChunkX, z = rz * 32 + (i >> 5) + playerChunkZ;
+				if ((limited && !box.contains(x, z)) || lookup.find(x, z) >= 0) continue;
+				if (writer.removeChunk(x - playerChunkX, z - playerChunkZ)) removed++;
+			}
+		}
+		writer.releaseRegion(rx, rz);
+	};
+	EncodedColumn col;
+	auto next = [&](EncodedColumn& c) {
+		ProfileScope scope(STAGE_WRITER_IDLE);
+		return queue.pop(c);
+	};
+	while (next(col)) {
+		ProfileScope scope(STAGE_WRITE);
+        long long region = regionKeyOf(col.cx, col.cz);
+        int x = col.cx + playerChunkX, z = col.cz + playerChunkZ;
+        if (col.failed) {
+            failed++;
+            if (col.payload.capacity()) queue.recycle(std::move(col.payload));
+            if (--regionColumns[region] == 0) release(col.cx, col.cz);
+            continue;
+        }
+        if (col.unchanged) {
+            // already in the region file
+            const ConversionManifest::Entry* e = previous.find(x, z);
+            current.set(x, z, e->key, e->location);
+            kept++;
+        }
+        else if (col.payload.empty()) {
+            skippedAir++;
+            // a column that has become all air loses its old chunk
+            if (updating && writer.removeChunk(col.cx, col.cz)) removed++;
+            if (--regionColumns[region] == 0) release(col.cx, col.cz);
+            continue;
+        }
+        else {
+            Profiler::count(COUNTER_BYTES_WRITTEN, col.payload.size());
+            uint32_t location = writer.writePayload(col.cx, col.cz, std::move(col.payload));
+            if (location) current.set(x, z, col.key, location);
+            // buffers come back once the I/O layer has written them
+            vector<uint8_t> spare;
+            while (writer.reclaimPayload(spare)) queue.recycle(std::move(spare));
+            exported++;
+            if (exported % 128 == 0) printf("Exported %d chunks...\n", exported);
+        }
+        if (col.cx < minCX) minCX = col.cx;
+        if (col.cx > maxCX) maxCX = col.cx;
+        if (col.cz < minCZ) minCZ = col.cz;
+        if (col.cz > maxCZ) maxCZ = col.cz;
+        if (--regionColumns[region] == 0) release(col.cx, col.cz);
 	}
-
-    writer.close();
+	for (auto& t : workers) t.join();
+
+	bool complete;
+	{
+		ProfileScope scope(STAGE_WRITE);
+		previous.forEach([&](int x, int z, const ConversionManifest::Entry& e) {
+			// outside the converted area the previous chunks stay as they are
+			if (limited && !box.contains(x, z)) {
+				current.set(x, z, e.key, e.location);
+				return;
+			}
+			// columns deleted from the world since the previous conversion
+			if (lookup.find(x, z) >= 0) return;
+			if (writer.removeChunk(x - playerChunkX, z - playerChunkZ)) removed++;
+		});
+		complete = writer.close();
+	}
+	if (failed) printf("%d columns could not be converted\n", failed);
+	if (complete && !failed) current.save(manifestPath, manifestSettings);
+	else printf("Conversion incomplete; no manifest written, the next conversion redoes every column\n");
+    mapped->close();
     fclose(fp);
-    printf("Done. Exported %d chunk columns. Chunk range X:[%d..%d] Z:[%d..%d].\n", exported, minCX, maxCX, minCZ, maxCZ);
+    fp = NULL;
+    if (skippedAir) printf("Skipped %d all-air columns.\n", skippedAir);
+    if (reused) printf("Reused %d chunks from columns with identical content.\n", reused.load());
+    if (kept) printf("Kept %d unchanged chunks from the previous conversion.\n", kept);
+    if (removed) printf("Removed %d chunks of columns that are gone or all air now.\n", removed);
+    if (minCX > maxCX) printf("Done. Exported %d chunk columns.\n", exported);
+    else printf("Done. Exported %d chunk columns. Chunk range X:[%d..%d] Z:[%d..%d].\n", exported, minCX, maxCX, minCZ, maxCZ);
     printf("Check for region file(s) in ConvertedWorld/region like r.%d.%d.mca covering origin r.0.0.mca.\n", 0, 0);
+	if (profiling) {
+		Profiler::stop();
+		Profiler::printSummary();
+		if (!tracePath.empty() && Profiler::writeTrace(tracePath.c_str())) printf("Trace written to %s\n", tracePath.c_str());
+	}
 }
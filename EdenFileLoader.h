@@ -15,6 +15,13 @@
 
 
 #pragma once
+#include "AnvilWriter.h"
+#include "ColumnLookup.h"
+#include "Compression.h"
+#include "RegionIO.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
 #define FILE_VERSION 4
 
 //File block data is subdivided into CHUNK_SIZE x CHUNK_SIZE x CHUNK_SIZE parts
@@ -25,6 +32,10 @@
 #define T_SIZE (T_READ_RADIUS*2*CHUNK_SIZE)
 #define T_HEIGHT 64
 
+//each column in the file is this many chunks stacked vertically, every chunk is its block array followed by its color array
+#define CHUNKS_PER_COLUMN_IN_FILE 4
+#define COLUMN_BYTES_IN_FILE (CHUNKS_PER_COLUMN_IN_FILE * CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * (sizeof(block8) + sizeof(color8)))
+
 
 //program expects blockarray and colorarray to be declared and allocated by the parent file
 #define GBLOCK(x,z,y)  blockarray[((x)*(T_SIZE*T_HEIGHT) + ((z)*T_HEIGHT) + (y))]
@@ -65,16 +76,86 @@ typedef struct {
 	unsigned long long chunk_offset;
 }ColumnIndex;
 
+// Part of the world convertToMinecraft exports
+enum ConversionAreaKind {
+	AREA_ALL = 0,
+	AREA_BOX,    // chunk box in output coordinates, i.e. after recentering on the player
+	AREA_PLAYER, // square of chunks centred on the player's chunk
+	AREA_HOME    // the same centred on the home position's chunk
+};
+
+struct ConversionArea {
+	ConversionAreaKind kind = AREA_ALL;
+	int minX = 0, minZ = 0, maxX = 0, maxZ = 0; // AREA_BOX, inclusive
+	// AREA_PLAYER, AREA_HOME: chunks on each side of the centre chunk, so the square is 2 * radius + 1
+	// chunks wide (loadWorld's T_READ_RADIUS window is 2 * radius, one less past the centre)
+	int radius = 0;
+};
+
+
 
+class EdenMappedFile;
 
 class EdenFileLoader {
 public:
+	EdenFileLoader();
+	~EdenFileLoader();
 	void loadWorld(char* name);
-	// New: Convert entire Eden world to Minecraft (1.12 Anvil) at output directory
+	// New: Convert entire Eden world to Minecraft (Anvil, 1.12 or 1.16 chunks) at output directory
 	void convertToMinecraft(const char* edenPath, const char* outputWorldDir);
+	// Read column data through a read-only mmap of the file instead of fseek/fread (default on)
+	void setUseMmap(bool enable) { useMmap = enable; }
+	// Number of conversion worker threads; 0 uses one per hardware thread (default)
+	void setThreadCount(int n) { threadCount = n; }
+	// Chunk compression backend and level (default zlib level 1)
+	void setCompression(const CompressionSettings& settings) { compression = settings; }
+	// Write regions to .tmp files and rename them into place when complete
+	void setCrashSafeOutput(bool enable) { crashSafe = enable; }
+	// Region output backend (default auto: io_uring when available, else a writer thread pool)
+	void setRegionIO(RegionIOBackend backend) { regionIO = backend; }
+	// Cap on region files open at once (0 = no limit); least recently used ones are closed first
+	void setMaxOpenRegions(int n) { maxOpenRegions = n; }
+	// Compute sky and block light for every chunk (default on); off writes full skylight everywhere
+	void setLighting(bool enable) { lighting = enable; }
+	// Reuse the encoded chunk of repeating column content for later identical columns (default on)
+	void setDedup(bool enable) { dedup = enable; }
+	// Chunk NBT layout (default 1.12; 1.16 writes palette sections)
+	void setChunkFormat(ChunkFormat format) { chunkFormat = format; }
+	// Print time per stage, throughput and compression ratio after converting (see Profiler)
+	void setProfile(bool enable) { profile = enable; }
+	// Also record every stage of every column and write them as a Chrome trace to path ("" = off)
+	void setTracePath(const char* path) { tracePath = path; }
+	// Reuse a previous conversion in the output directory (default on): with its manifest and the
+	// same settings only changed columns are converted again, and chunks of removed columns dropped
+	void setIncremental(bool enable) { incremental = enable; }
+	// Export only part of the world (default all). Columns outside are not read, except as light
+	// neighbours of the border, and regions outside are not created. Existing region files the area
+	// touches are always updated in place, so their chunks outside the area survive
+	void setArea(const ConversionArea& a) { area = a; }
 private:
 	bool readColumn(int cx, int cz);
 	void readDirectory();
+	bool openMapping(const char* path);
+	bool useMmap;
+	EdenMappedFile* mapped;
+	int threadCount;
+	CompressionSettings compression;
+	bool crashSafe;
+	RegionIOBackend regionIO;
+	int maxOpenRegions;
+	bool lighting;
+	bool dedup;
+	ChunkFormat chunkFormat;
+	bool profile;
+	std::string tracePath;
+	bool incremental;
+	ConversionArea area;
+
+	FILE* fp;
+	WorldFileHeader* sfh;
+	std::vector<ColumnIndex> colindexes; // flat, in directory order
+	int num_columns;
+	ColumnLookup lookup; // (x,z) -> position in colindexes
 };
 
 
@@ -0,0 +1,73 @@
+#include "EdenMappedFile.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+EdenMappedFile::EdenMappedFile(): fd(-1), base(nullptr), length(0) {}
+
+EdenMappedFile::~EdenMappedFile() {
+	close();
+}
+
+bool EdenMappedFile::open(const char* path) {
+	close();
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(WorldFileHeader)) {
+		close();
+		return false;
+	}
+	length = (uint64_t)st.st_size;
+
+	void* p = mmap(nullptr, (size_t)length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		printf("mmap of %s failed, falling back to buffered reads\n", path);
+		close();
+		return false;
+	}
+	base = (uint8_t*)p;
+
+	// Columns are converted front to back, let the kernel read ahead aggressively
+	madvise(base, (size_t)length, MADV_SEQUENTIAL);
+	// The directory is needed first, ask for it up front
+	uint64_t dirOffset = header()->directory_offset;
+	if (dirOffset < length) {
+		long page = sysconf(_SC_PAGESIZE);
+		uint64_t start = dirOffset & ~(uint64_t)(page - 1);
+		madvise(base + start, (size_t)(length - start), MADV_WILLNEED);
+	}
+	return true;
+}
+
+void EdenMappedFile::close() {
+	if (base) munmap(base, (size_t)length);
+	if (fd >= 0) ::close(fd);
+	base = nullptr;
+	fd = -1;
+	length = 0;
+}
+
+const uint8_t* EdenMappedFile::range(uint64_t offset, uint64_t len) const {
+	if (!base || offset > length || length - offset < len) return nullptr;
+	return base + offset;
+}
+
+const WorldFileHeader* EdenMappedFile::header() const {
+	return (const WorldFileHeader*)base;
+}
+
+bool EdenMappedFile::column(const ColumnIndex& ci, ColumnView& out) const {
+	const uint8_t* p = range(ci.chunk_offset, COLUMN_BYTES_IN_FILE);
+	if (!p) return false;
+	for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) {
+		out.blocks[cy] = (const block8*)p;
+		p += CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * sizeof(block8);
+		out.colors[cy] = (const color8*)p;
+		p += CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE * sizeof(color8);
+	}
+	return true;
+}
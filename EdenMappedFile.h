@@ -0,0 +1,39 @@
+#pragma once
+#include "EdenFileLoader.h"
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of an .eden file.
+// Column chunks are handed out as views straight into the mapping, nothing is copied.
+
+// Pointers to the block and color arrays of each chunk in one column (cy = 0..3)
+struct ColumnView {
+	const block8* blocks[CHUNKS_PER_COLUMN_IN_FILE];
+	const color8* colors[CHUNKS_PER_COLUMN_IN_FILE];
+};
+
+class EdenMappedFile {
+public:
+	EdenMappedFile();
+	~EdenMappedFile();
+
+	// Map the whole file read-only; returns false if the file can't be opened or mapped
+	bool open(const char* path);
+	void close();
+
+	bool isOpen() const { return base != nullptr; }
+	uint64_t size() const { return length; }
+
+	// Returns a pointer to [offset, offset+len) or nullptr if the range is outside the file
+	const uint8_t* range(uint64_t offset, uint64_t len) const;
+
+	const WorldFileHeader* header() const;
+
+	// Fill views for the column at ci.chunk_offset; false if the column runs past end of file
+	bool column(const ColumnIndex& ci, ColumnView& out) const;
+
+private:
+	int fd;
+	uint8_t* base;
+	uint64_t length;
+};
@@ -0,0 +1,301 @@
+#include "LightEngine.h"
+#include "BlockMap.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64)
+#define LIGHTENGINE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static const int N = 16;
+static const int HEIGHT = CHUNKS_PER_COLUMN_IN_FILE * N; // 64: one bit per block in a uint64
+static const int G = 3 * N + 2;                          // neighbourhood plus walls, per side
+static const int COLS = G * G;
+static const int LEVELS = 16;
+static const int MAX_DENSE = 4;                          // opacity classes between 2 and 14
+
+static_assert(HEIGHT == 64, "a column must fit one 64-bit mask");
+
+static inline int lowestBit(uint64_t v) {
+#if defined(__GNUC__)
+	return __builtin_ctzll(v);
+#else
+	int n = 0;
+	while (!(v & 1)) { v >>= 1; n++; }
+	return n;
+#endif
+}
+
+static inline int highestBit(uint64_t v) {
+#if defined(__GNUC__)
+	return 63 - __builtin_clzll(v);
+#else
+	int n = 63;
+	while (!(v >> 63)) { v <<= 1; n--; }
+	return n;
+#endif
+}
+
+static inline int colOf(int x, int z) {
+	return x * G + z;
+}
+
+// Minecraft 1.12 values; everything not listed is an opaque full block
+struct LightTable {
+	uint8_t emission[256];
+	uint8_t opacity[256];
+};
+
+static LightTable buildMinecraftLightTable() {
+	LightTable t;
+	memset(t.emission, 0, sizeof(t.emission));
+	memset(t.opacity, 15, sizeof(t.opacity));
+	static const uint8_t clearIds[] = {
+		0, 6, 10, 11, 20, 27, 28, 31, 32, 37, 38, 39, 40, 50, 51, 55, 59, 63, 64, 65, 66, 68, 69, 70,
+		71, 72, 75, 76, 77, 83, 85, 90, 93, 94, 95, 96, 101, 102, 104, 105, 106, 107, 111, 113, 115,
+		131, 132, 139, 140, 141, 142, 143, 147, 148, 149, 150, 157, 160, 171, 175, 176, 177
+	};
+	for (uint8_t id : clearIds) t.opacity[id] = 0;
+	t.opacity[8] = t.opacity[9] = 3;    // water
+	t.opacity[79] = 3;                  // ice
+	t.opacity[18] = t.opacity[161] = 1; // leaves
+	t.opacity[30] = 1;                  // cobweb
+	static const uint8_t bright[] = { 10, 11, 51, 89, 91, 119, 124, 138, 169 };
+	for (uint8_t id : bright) t.emission[id] = 15;
+	t.emission[50] = 14; // torch
+	t.emission[62] = 13; // lit furnace
+	t.emission[76] = 7;  // redstone torch
+	t.emission[94] = 9;  // powered repeater
+	return t;
+}
+
+static const LightTable& minecraftLightTable() {
+	static const LightTable t = buildMinecraftLightTable();
+	return t;
+}
+
+uint8_t minecraftLightEmission(uint8_t mcId) {
+	return minecraftLightTable().emission[mcId];
+}
+
+uint8_t minecraftLightOpacity(uint8_t mcId) {
+	return minecraftLightTable().opacity[mcId];
+}
+
+// Block class bits per Eden id, so masks are built straight from the raw chunks
+enum {
+	CLASS_PASSABLE = 1,
+	CLASS_CLEAR = 2,
+	CLASS_THIN = 4,
+	CLASS_EMITS = 8,
+	CLASS_DENSE = 16 // CLASS_DENSE << k for dense class k
+};
+
+struct EdenLightClasses {
+	uint8_t cls[256];
+	uint8_t emission[256];
+	int denseCost[MAX_DENSE];
+	int denseCount;
+};
+
+static EdenLightClasses buildEdenLightClasses() {
+	const MCMapping* map = edenToMinecraftTable();
+	const LightTable& mc = minecraftLightTable();
+	EdenLightClasses t;
+	t.denseCount = 0;
+	for (int i = 0; i < 256; i++) {
+		uint8_t id = map[i].place ? map[i].id : 0;
+		int op = mc.opacity[id];
+		uint8_t c = 0;
+		if (op < 15) c |= CLASS_PASSABLE;
+		if (op == 0) c |= CLASS_CLEAR;
+		if (op <= 1) c |= CLASS_THIN;
+		if (op > 1 && op < 15) {
+			int k = 0;
+			while (k < t.denseCount && t.denseCost[k] != op) k++;
+			if (k == t.denseCount && k < MAX_DENSE) t.denseCost[t.denseCount++] = op;
+			// more distinct opacities than classes: treat the block as opaque
+			if (k < MAX_DENSE) c |= CLASS_DENSE << k;
+			else c &= ~CLASS_PASSABLE;
+		}
+		if (mc.emission[id]) c |= CLASS_EMITS;
+		t.cls[i] = c;
+		t.emission[i] = mc.emission[id];
+	}
+	return t;
+}
+
+static const EdenLightClasses& edenLightClasses() {
+	static const EdenLightClasses t = buildEdenLightClasses();
+	return t;
+}
+
+LightEngine::LightEngine(): passable(COLS, 0), clear(COLS, 0), thin(COLS, 0), dense(MAX_DENSE * COLS, 0),
+	pending(LEVELS * COLS, 0), visited(COLS, 0), spread(COLS, 0), reach(COLS, 15) {
+	// Light drops by at least 1 per block, so a block only matters for the centre column while its
+	// light exceeds its horizontal (Manhattan) distance to it
+	for (int x = 1; x < G - 1; x++) {
+		for (int z = 1; z < G - 1; z++) {
+			int dx = x <= N ? N + 1 - x : (x > 2 * N ? x - 2 * N : 0);
+			int dz = z <= N ? N + 1 - z : (z > 2 * N ? z - 2 * N : 0);
+			reach[colOf(x, z)] = (uint8_t)(dx + dz > 15 ? 15 : dx + dz);
+		}
+	}
+}
+
+// 16 class bytes (one Eden chunk's x,z run, y = 0..15) -> 16-bit mask of those with bit set
+static inline unsigned classMask(const uint8_t* cls16, uint8_t bit) {
+#ifdef LIGHTENGINE_SSE2
+	__m128i v = _mm_loadu_si128((const __m128i*)cls16);
+	__m128i b = _mm_set1_epi8((char)bit);
+	return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, b), b));
+#else
+	unsigned m = 0;
+	for (int y = 0; y < N; y++) m |= (unsigned)((cls16[y] & bit) != 0) << y;
+	return m;
+#endif
+}
+
+void LightEngine::fill(const ColumnView* const neighborhood[3][3]) {
+	const EdenLightClasses& t = edenLightClasses();
+	sources.clear();
+	for (int ax = 0; ax < 3; ax++) {
+		for (int az = 0; az < 3; az++) {
+			const ColumnView* v = neighborhood[ax][az];
+			for (int lx = 0; lx < N; lx++) {
+				for (int lz = 0; lz < N; lz++) {
+					int c = colOf(ax * N + lx + 1, az * N + lz + 1);
+					if (!v) {
+						passable[c] = clear[c] = thin[c] = ~0ULL;
+						for (int k = 0; k < t.denseCount; k++) dense[k * COLS + c] = 0;
+						continue;
+					}
+					uint64_t p = 0, cl = 0, th = 0, d[MAX_DENSE] = {};
+					for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) {
+						// Eden chunks are x,z,y ordered, so each x,z is 16 consecutive bytes
+						const uint8_t* src = (const uint8_t*)v->blocks[cy] + lx * N * N + lz * N;
+						alignas(16) uint8_t cls[N];
+						for (int y = 0; y < N; y++) cls[y] = t.cls[src[y]];
+						int shift = cy * N;
+						p |= (uint64_t)classMask(cls, CLASS_PASSABLE) << shift;
+						cl |= (uint64_t)classMask(cls, CLASS_CLEAR) << shift;
+						th |= (uint64_t)classMask(cls, CLASS_THIN) << shift;
+						for (int k = 0; k < t.denseCount; k++) d[k] |= (uint64_t)classMask(cls, (uint8_t)(CLASS_DENSE << k)) << shift;
+						unsigned emits = classMask(cls, CLASS_EMITS);
+						for (int y = 0; emits; y++, emits >>= 1) {
+							if (emits & 1) {
+								Source s = { c, shift + y, t.emission[src[y]] };
+								sources.push_back(s);
+							}
+						}
+					}
+					passable[c] = p;
+					clear[c] = cl;
+					thin[c] = th;
+					for (int k = 0; k < t.denseCount; k++) dense[k * COLS + c] = d[k];
+				}
+			}
+		}
+	}
+}
+
+int LightEngine::opacityAt(int c, int y) const {
+	uint64_t bit = 1ULL << y;
+	if (!(passable[c] & bit)) return 15;
+	if (clear[c] & bit) return 0;
+	if (thin[c] & bit) return 1;
+	const EdenLightClasses& t = edenLightClasses();
+	for (int k = 0; k < t.denseCount; k++) {
+		if (dense[k * COLS + c] & bit) return t.denseCost[k];
+	}
+	return 15;
+}
+
+// Straight down from the sky: full light through clear blocks, then minus the opacity
+// (at least 1) per block, as Minecraft's initial skylight pass does
+void LightEngine::seedSky() {
+	memset(pending.data(), 0, pending.size() * sizeof(uint64_t));
+	for (int x = 1; x < G - 1; x++) {
+		for (int z = 1; z < G - 1; z++) {
+			int c = colOf(x, z);
+			uint64_t blocked = ~clear[c];
+			// everything above the highest non-clear block sees the sky
+			int y = blocked ? highestBit(blocked) : -1;
+			uint64_t open = y == 63 ? 0 : ~0ULL << (y + 1);
+			if (15 > reach[c]) pending[15 * COLS + c] |= open;
+			int k = 15;
+			for (; y >= 0; y--) {
+				int op = opacityAt(c, y);
+				k -= op ? op : 1;
+				if (k <= reach[c]) break;
+				pending[k * COLS + c] |= 1ULL << y;
+			}
+		}
+	}
+}
+
+void LightEngine::seedBlock() {
+	memset(pending.data(), 0, pending.size() * sizeof(uint64_t));
+	for (const Source& s : sources) {
+		if (s.level > reach[s.col]) pending[s.level * COLS + s.col] |= 1ULL << s.y;
+	}
+}
+
+// Level by level, brightest first: blocks pending at a level and not yet final take that level,
+// then their neighbours (one bit over in y, one column over in x/z) become pending at the level
+// minus their opacity. Walls are never passable
+void LightEngine::flood(uint8_t out[][2048]) {
+	const EdenLightClasses& t = edenLightClasses();
+	memset(visited.data(), 0, visited.size() * sizeof(uint64_t));
+	for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) memset(out[cy], 0, 2048);
+
+	for (int level = LEVELS - 1; level >= 1; level--) {
+		const uint64_t* now = &pending[level * COLS];
+		bool any = false;
+		for (int x = 1; x < G - 1; x++) {
+			for (int z = 1; z < G - 1; z++) {
+				int c = colOf(x, z);
+				uint64_t f = now[c] & ~visited[c];
+				if (!f) continue;
+				visited[c] |= f;
+				any = true;
+				// unpack only the centre column
+				if (x > N && x <= 2 * N && z > N && z <= 2 * N) {
+					int lx = x - N - 1, lz = z - N - 1;
+					for (uint64_t bits = f; bits; bits &= bits - 1) {
+						int y = lowestBit(bits);
+						int i = ((y & 15) * N + lz) * N + lx;
+						out[y >> 4][i >> 1] |= (uint8_t)(level << (4 * (lx & 1)));
+					}
+				}
+				if (level == 1) continue;
+				spread[c] |= (f << 1) | (f >> 1);
+				spread[c + 1] |= f;
+				spread[c - 1] |= f;
+				spread[c + G] |= f;
+				spread[c - G] |= f;
+			}
+		}
+		if (!any || level == 1) continue;
+		for (int c = 0; c < COLS; c++) {
+			uint64_t s = spread[c];
+			if (!s) continue;
+			spread[c] = 0;
+			uint64_t cand = s & passable[c] & ~visited[c];
+			if (!cand) continue;
+			if (level - 1 > reach[c]) pending[(level - 1) * COLS + c] |= cand & thin[c];
+			for (int k = 0; k < t.denseCount; k++) {
+				int to = level - t.denseCost[k];
+				if (to > reach[c]) pending[to * COLS + c] |= cand & dense[k * COLS + c];
+			}
+		}
+	}
+}
+
+void LightEngine::compute(const ColumnView* const neighborhood[3][3], ColumnLight& out) {
+	fill(neighborhood);
+	seedSky();
+	flood(out.sky);
+	seedBlock();
+	flood(out.block);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "EdenMappedFile.h"
+#include <cstdint>
+#include <vector>
+
+// Sky and block light for one column, computed from the Eden blocks of the column and its eight
+// neighbours. Light travels at most 15 blocks, so everything that can reach the centre column
+// lies inside that 3x3 neighbourhood: seams come out the same as if the whole world were lit
+// at once, while every column can still be lit independently on any worker thread.
+
+// SkyLight and BlockLight nibble arrays per section, in Anvil order ((y*16+z)*16+x, even x in the low nibble)
+struct ColumnLight {
+	uint8_t sky[CHUNKS_PER_COLUMN_IN_FILE][2048];
+	uint8_t block[CHUNKS_PER_COLUMN_IN_FILE][2048];
+};
+
+// Light emitted by / absorbed by a Minecraft 1.12 block id (opacity 15 stops light entirely)
+uint8_t minecraftLightEmission(uint8_t mcId);
+uint8_t minecraftLightOpacity(uint8_t mcId);
+
+// Flood fill on bitmasks: a column is 64 blocks tall, so each x,z of the neighbourhood is one
+// 64-bit word per block class (passable, clear, ...) and per light level. Light is spread one
+// level at a time, brightest first, by shifting and OR-ing whole words; the first level that
+// reaches a block is its light, and only the centre column's values are ever unpacked.
+class LightEngine {
+public:
+	LightEngine();
+
+	// neighborhood[dx+1][dz+1] is the column at (cx+dx, cz+dz), nullptr if the world has none
+	// there (treated as open air). Only the block arrays of the views are read
+	void compute(const ColumnView* const neighborhood[3][3], ColumnLight& out);
+
+private:
+	struct Source {
+		int col, y, level;
+	};
+
+	void fill(const ColumnView* const neighborhood[3][3]);
+	void seedSky();
+	void seedBlock();
+	void flood(uint8_t out[][2048]);
+	int opacityAt(int col, int y) const;
+
+	// 50x50 words: the 48x48 neighbourhood plus a wall column on every side (never passable)
+	std::vector<uint64_t> passable; // opacity < 15
+	std::vector<uint64_t> clear;    // opacity 0
+	std::vector<uint64_t> thin;     // opacity 0 or 1, light drops by 1
+	std::vector<uint64_t> dense;    // per denser class (e.g. water): light drops by its opacity
+	std::vector<uint64_t> pending;  // per level: blocks reached at that level
+	std::vector<uint64_t> visited;  // blocks whose light is final
+	std::vector<uint64_t> spread;   // scratch: neighbours of this level's blocks
+	std::vector<uint8_t> reach;     // per column: distance to the centre, light at or below it is skipped
+	std::vector<Source> sources;    // emitting blocks found by fill()
+};
@@ -1,79 +1,152 @@
 #include "NBT.h"
+#include <cstdlib>
+#include <cstring>
 #include <zlib.h>
 
 namespace nbt {
 
-static void writeBE32(std::vector<uint8_t>& out, uint32_t v) {
-	out.push_back((v >> 24) & 0xFF);
-	out.push_back((v >> 16) & 0xFF);
-	out.push_back((v >> 8) & 0xFF);
-	out.push_back(v & 0xFF);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+static inline uint16_t toBE16(uint16_t v) { return v; }
+static inline uint32_t toBE32(uint32_t v) { return v; }
+static inline uint64_t toBE64(uint64_t v) { return v; }
+#elif defined(_MSC_VER)
+static inline uint16_t toBE16(uint16_t v) { return _byteswap_ushort(v); }
+static inline uint32_t toBE32(uint32_t v) { return _byteswap_ulong(v); }
+static inline uint64_t toBE64(uint64_t v) { return _byteswap_uint64(v); }
+#else
+static inline uint16_t toBE16(uint16_t v) { return __builtin_bswap16(v); }
+static inline uint32_t toBE32(uint32_t v) { return __builtin_bswap32(v); }
+static inline uint64_t toBE64(uint64_t v) { return __builtin_bswap64(v); }
+#endif
+
+// Grow by n bytes and return where they start
+static inline uint8_t* grow(std::vector<uint8_t>& out, size_t n) {
+	size_t at = out.size();
+	out.resize(at + n);
+	return out.data() + at;
+}
+
+// Buffer writes go through here so an attached sink gets flushed before the buffer grows past flushAt
+static inline uint8_t* grow(Buffer& buf, size_t n) {
+	if (buf.sink && buf.data.size() >= buf.flushAt) buf.flush();
+	return grow(buf.data, n);
+}
+
+template <typename Out>
+static void writeBE32(Out& out, uint32_t v) {
+	v = toBE32(v);
+	memcpy(grow(out, 4), &v, 4);
+}
+
+template <typename Out>
+static void writeBE16(Out& out, uint16_t v) {
+	v = toBE16(v);
+	memcpy(grow(out, 2), &v, 2);
+}
+
+template <typename Out>
+static void writeBE64(Out& out, uint64_t v) {
+	v = toBE64(v);
+	memcpy(grow(out, 8), &v, 8);
+}
+
+void Buffer::flush() {
+	if (!sink || data.empty()) return;
+	if (!sink->write(data.data(), data.size())) failed = true;
+	data.clear();
 }
 
-static void writeBE16(std::vector<uint8_t>& out, uint16_t v) {
-	out.push_back((v >> 8) & 0xFF);
-	out.push_back(v & 0xFF);
+void Buffer::writeU8(uint8_t v) { *grow(*this, 1) = v; }
+void Buffer::writeI16(int16_t v) { writeBE16(*this, (uint16_t)v); }
+void Buffer::writeI32(int32_t v) { writeBE32(*this, (uint32_t)v); }
+void Buffer::writeI64(int64_t v) { writeBE64(*this, (uint64_t)v); }
+void Buffer::writeBytes(const uint8_t* p, size_t n) {
+	if (!n) return;
+	// append directly, resize() would zero the bytes first
+	if (sink && data.size() >= flushAt) flush();
+	data.insert(data.end(), p, p + n);
 }
 
-static void writeBE64(std::vector<uint8_t>& out, uint64_t v) {
-	for (int i = 7; i >= 0; --i) out.push_back((v >> (i*8)) & 0xFF);
+void Buffer::writeI32Array(const int32_t* p, size_t n) {
+	uint8_t* out = grow(*this, n * 4);
+	for (size_t i = 0; i < n; i++) {
+		uint32_t v = toBE32((uint32_t)p[i]);
+		memcpy(out + i * 4, &v, 4);
+	}
 }
 
-void Buffer::writeU8(uint8_t v) { data.push_back(v); }
-void Buffer::writeI16(int16_t v) { writeBE16(data, (uint16_t)v); }
-void Buffer::writeI32(int32_t v) { writeBE32(data, (uint32_t)v); }
-void Buffer::writeI64(int64_t v) { writeBE64(data, (uint64_t)v); }
-void Buffer::writeBytes(const uint8_t* p, size_t n) { data.insert(data.end(), p, p+n); }
+void Buffer::writeI64Array(const int64_t* p, size_t n) {
+	uint8_t* out = grow(*this, n * 8);
+	for (size_t i = 0; i < n; i++) {
+		uint64_t v = toBE64((uint64_t)p[i]);
+		memcpy(out + i * 8, &v, 8);
+	}
+}
 
-void writeTagHeader(Buffer& buf, TagType type, const std::string& name) {
+void writeTagHeader(Buffer& buf, TagType type, const char* name) {
 	buf.writeU8((uint8_t)type);
-	writeBE16(buf.data, (uint16_t)name.size());
-	buf.writeBytes(reinterpret_cast<const uint8_t*>(name.data()), name.size());
+	size_t len = strlen(name);
+	writeBE16(buf, (uint16_t)len);
+	buf.writeBytes(reinterpret_cast<const uint8_t*>(name), len);
 }
 
 void writeEnd(Buffer& buf) {
 	buf.writeU8((uint8_t)TAG_End);
 }
 
-void writeByte(Buffer& buf, const std::string& name, int8_t value) {
+void writeByte(Buffer& buf, const char* name, int8_t value) {
 	writeTagHeader(buf, TAG_Byte, name);
 	buf.writeU8((uint8_t)value);
 }
 
-void writeShort(Buffer& buf, const std::string& name, int16_t value) {
+void writeShort(Buffer& buf, const char* name, int16_t value) {
 	writeTagHeader(buf, TAG_Short, name);
 	buf.writeI16(value);
 }
 
-void writeInt(Buffer& buf, const std::string& name, int32_t value) {
+void writeInt(Buffer& buf, const char* name, int32_t value) {
 	writeTagHeader(buf, TAG_Int, name);
 	buf.writeI32(value);
 }
 
-void writeLong(Buffer& buf, const std::string& name, int64_t value) {
+void writeLong(Buffer& buf, const char* name, int64_t value) {
 	writeTagHeader(buf, TAG_Long, name);
 	buf.writeI64(value);
 }
 
-void writeString(Buffer& buf, const std::string& name, const std::string& value) {
+void writeString(Buffer& buf, const char* name, const std::string& value) {
 	writeTagHeader(buf, TAG_String, name);
-	writeBE16(buf.data, (uint16_t)value.size());
+	writeBE16(buf, (uint16_t)value.size());
 	buf.writeBytes(reinterpret_cast<const uint8_t*>(value.data()), value.size());
 }
 
-void writeByteArray(Buffer& buf, const std::string& name, const std::vector<uint8_t>& value) {
+void writeByteArray(Buffer& buf, const char* name, const std::vector<uint8_t>& value) {
+	writeByteArray(buf, name, value.data(), value.size());
+}
+
+void writeByteArray(Buffer& buf, const char* name, const uint8_t* value, size_t count) {
 	writeTagHeader(buf, TAG_Byte_Array, name);
-	buf.writeI32((int32_t)value.size());
-	if (!value.empty()) buf.writeBytes(value.data(), value.size());
+	buf.writeI32((int32_t)count);
+	if (count) buf.writeBytes(value, count);
+}
+
+void writeIntArray(Buffer& buf, const char* name, const std::vector<int32_t>& value) {
+	writeIntArray(buf, name, value.data(), value.size());
 }
 
-void writeIntArray(Buffer& buf, const std::string& name, const std::vector<int32_t>& value) {
+void writeIntArray(Buffer& buf, const char* name, const int32_t* value, size_t count) {
 	writeTagHeader(buf, TAG_Int_Array, name);
-	buf.writeI32((int32_t)value.size());
-	for (auto v : value) buf.writeI32(v);
+	buf.writeI32((int32_t)count);
+	buf.writeI32Array(value, count);
+}
+
+void writeLongArray(Buffer& buf, const char* name, const int64_t* value, size_t count) {
+	writeTagHeader(buf, TAG_Long_Array, name);
+	buf.writeI32((int32_t)count);
+	buf.writeI64Array(value, count);
 }
 
-void beginCompound(Buffer& buf, const std::string& name) {
+void beginCompound(Buffer& buf, const char* name) {
 	writeTagHeader(buf, TAG_Compound, name);
 }
 
@@ -81,7 +154,7 @@ void endCompound(Buffer& buf) {
 	writeEnd(buf);
 }
 
-void beginList(Buffer& buf, const std::string& name, TagType elemType, int32_t length) {
+void beginList(Buffer& buf, const char* name, TagType elemType, int32_t length) {
 	writeTagHeader(buf, TAG_List, name);
 	buf.writeU8((uint8_t)elemType);
 	buf.writeI32(length);
@@ -107,5 +180,3 @@ std::vector<uint8_t> compressZlib(const std::vector<uint8_t>& input) {
 }
 
 }
-
-
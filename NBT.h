@@ -24,32 +24,88 @@ enum TagType : uint8_t {
 	TAG_Long_Array = 12
 };
 
+// Receives encoded NBT bytes as a Buffer fills up, e.g. a compressor
+struct Sink {
+	virtual ~Sink() {}
+	virtual bool write(const uint8_t* p, size_t n) = 0;
+};
+
 struct Buffer {
 	std::vector<uint8_t> data;
+	// With a sink attached, data is handed over whenever it reaches flushAt bytes,
+	// so a chunk is compressed as it is encoded and never held in full
+	Sink* sink = nullptr;
+	size_t flushAt = 32 * 1024;
+	bool failed = false; // set if the sink rejected data
+
+	// Capacity is kept across clear(), so a buffer reused for every chunk stops reallocating after warm-up
+	void reserve(size_t n) { data.reserve(n); }
+	void clear() { data.clear(); failed = false; }
+	// Pass everything buffered to the sink (no-op without one)
+	void flush();
 	void writeU8(uint8_t v);
 	void writeI16(int16_t v);
 	void writeI32(int32_t v);
 	void writeI64(int64_t v);
 	void writeBytes(const uint8_t* p, size_t n);
+	// Bulk big-endian array writes (one resize, byte-swap loop the compiler vectorizes)
+	void writeI32Array(const int32_t* p, size_t n);
+	void writeI64Array(const int64_t* p, size_t n);
 };
 
-// Building blocks for NBT
-void writeTagHeader(Buffer& buf, TagType type, const std::string& name);
+// Building blocks for NBT. Names are plain C strings (normally literals), so writing a tag never allocates
+void writeTagHeader(Buffer& buf, TagType type, const char* name);
 void writeEnd(Buffer& buf);
-void writeByte(Buffer& buf, const std::string& name, int8_t value);
-void writeShort(Buffer& buf, const std::string& name, int16_t value);
-void writeInt(Buffer& buf, const std::string& name, int32_t value);
-void writeLong(Buffer& buf, const std::string& name, int64_t value);
-void writeString(Buffer& buf, const std::string& name, const std::string& value);
-void writeByteArray(Buffer& buf, const std::string& name, const std::vector<uint8_t>& value);
-void writeIntArray(Buffer& buf, const std::string& name, const std::vector<int32_t>& value);
+void writeByte(Buffer& buf, const char* name, int8_t value);
+void writeShort(Buffer& buf, const char* name, int16_t value);
+void writeInt(Buffer& buf, const char* name, int32_t value);
+void writeLong(Buffer& buf, const char* name, int64_t value);
+void writeString(Buffer& buf, const char* name, const std::string& value);
+void writeByteArray(Buffer& buf, const char* name, const std::vector<uint8_t>& value);
+void writeByteArray(Buffer& buf, const char* name, const uint8_t* value, size_t count);
+void writeIntArray(Buffer& buf, const char* name, const std::vector<int32_t>& value);
+void writeIntArray(Buffer& buf, const char* name, const int32_t* value, size_t count);
+void writeLongArray(Buffer& buf, const char* name, const int64_t* value, size_t count);
+
+// A tag header (type, name length, name), optionally followed by an array length, encoded at compile
+// time so it is written with a single memcpy:
+//   static constexpr auto BLOCKS = arrayHeader(TAG_Byte_Array, "Blocks", 4096);
+//   writeTagHeader(buf, BLOCKS); buf.writeBytes(blocks, 4096);
+template <size_t N>
+struct TagHeader {
+	uint8_t bytes[N + 6]; // type, 2 byte length, N-1 name bytes, 4 byte count
+	size_t size;
+};
+
+template <size_t N>
+constexpr TagHeader<N> tagHeader(TagType type, const char (&name)[N]) {
+	TagHeader<N> h{};
+	h.bytes[0] = (uint8_t)type;
+	h.bytes[1] = (uint8_t)((N - 1) >> 8);
+	h.bytes[2] = (uint8_t)(N - 1);
+	for (size_t i = 0; i + 1 < N; i++) h.bytes[3 + i] = (uint8_t)name[i];
+	h.size = N + 2;
+	return h;
+}
+
+template <size_t N>
+constexpr TagHeader<N> arrayHeader(TagType type, const char (&name)[N], int32_t count) {
+	TagHeader<N> h = tagHeader(type, name);
+	for (int shift = 24; shift >= 0; shift -= 8) h.bytes[h.size++] = (uint8_t)((uint32_t)count >> shift);
+	return h;
+}
+
+template <size_t N>
+inline void writeTagHeader(Buffer& buf, const TagHeader<N>& header) {
+	buf.writeBytes(header.bytes, header.size);
+}
 
 // Start/finish a compound manually
-void beginCompound(Buffer& buf, const std::string& name);
+void beginCompound(Buffer& buf, const char* name);
 void endCompound(Buffer& buf);
 
 // Start/finish a list (homogeneous type)
-void beginList(Buffer& buf, const std::string& name, TagType elemType, int32_t length);
+void beginList(Buffer& buf, const char* name, TagType elemType, int32_t length);
 
 // Write an unnamed compound payload suitable as a List element (no tag header)
 void beginCompoundPayload(Buffer& buf);
@@ -0,0 +1,177 @@
+#include "Profiler.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#if defined(_M_X64)
+#include <intrin.h>
+#define PROFILER_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_RDTSC 1
+#endif
+
+static const char* const stageNames[STAGE_COUNT] = {
+	"read", "map/pack", "light", "dedup", "NBT encode", "compress", "queue wait", "region write", "writer idle"
+};
+
+struct TraceEvent {
+	uint64_t begin, end;
+	ProfileStage stage;
+};
+
+struct Profiler::ThreadSlot {
+	uint64_t ticks[STAGE_COUNT] = {};
+	uint64_t calls[STAGE_COUNT] = {};
+	uint64_t counters[COUNTER_COUNT] = {};
+	std::vector<TraceEvent> events;
+	std::string name;
+	int id = 0;
+	ProfileScope* open = nullptr; // innermost running scope
+};
+
+bool Profiler::on = false;
+bool Profiler::tracing = false;
+
+static std::mutex slotsLock;
+static std::vector<std::unique_ptr<Profiler::ThreadSlot>> slots;
+static unsigned generation = 0; // bumped by start(); slots of an older run are gone
+static thread_local Profiler::ThreadSlot* mySlot = nullptr;
+static thread_local unsigned mySlotGeneration = 0;
+
+static uint64_t startTick, stopTick;
+static std::chrono::steady_clock::time_point startTime, stopTime;
+static bool stopped;
+
+static inline uint64_t nowTicks() {
+#ifdef PROFILER_RDTSC
+	return __rdtsc();
+#else
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Cycle counter rate over the run, measured against the steady clock
+static double ticksPerSecond() {
+	uint64_t endTick = stopped ? stopTick : nowTicks();
+	auto endTime = stopped ? stopTime : std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(endTime - startTime).count();
+	if (seconds <= 0 || endTick <= startTick) return 1e9;
+	return (double)(endTick - startTick) / seconds;
+}
+
+void Profiler::start(bool trace) {
+	std::lock_guard<std::mutex> lock(slotsLock);
+	slots.clear();
+	generation++;
+	tracing = trace;
+	stopped = false;
+	startTime = std::chrono::steady_clock::now();
+	startTick = nowTicks();
+	on = true;
+}
+
+void Profiler::stop() {
+	if (!on) return;
+	stopTick = nowTicks();
+	stopTime = std::chrono::steady_clock::now();
+	stopped = true;
+	on = false;
+}
+
+Profiler::ThreadSlot* Profiler::slot() {
+	if (mySlot && mySlotGeneration == generation) return mySlot;
+	std::lock_guard<std::mutex> lock(slotsLock);
+	slots.emplace_back(new ThreadSlot());
+	mySlot = slots.back().get();
+	mySlot->id = (int)slots.size();
+	mySlotGeneration = generation;
+	return mySlot;
+}
+
+void Profiler::nameThread(const char* name) {
+	if (on) slot()->name = name;
+}
+
+void Profiler::count(ProfileCounter counter, uint64_t n) {
+	if (on) slot()->counters[counter] += n;
+}
+
+ProfileScope::ProfileScope(ProfileStage stage): thread(nullptr), parent(nullptr), stage(stage), begin(0), nested(0) {
+	if (!Profiler::on) return;
+	thread = Profiler::slot();
+	parent = thread->open;
+	thread->open = this;
+	begin = nowTicks();
+}
+
+ProfileScope::~ProfileScope() {
+	if (!thread) return;
+	uint64_t end = nowTicks();
+	uint64_t elapsed = end - begin;
+	thread->ticks[stage] += elapsed - nested;
+	thread->calls[stage]++;
+	if (parent) parent->nested += elapsed;
+	thread->open = parent;
+	if (Profiler::tracing) thread->events.push_back({ begin, end, stage });
+}
+
+void Profiler::printSummary() {
+	std::lock_guard<std::mutex> lock(slotsLock);
+	double rate = ticksPerSecond();
+	uint64_t ticks[STAGE_COUNT] = {}, calls[STAGE_COUNT] = {}, counters[COUNTER_COUNT] = {};
+	uint64_t allTicks = 0;
+	for (auto& s : slots) {
+		for (int i = 0; i < STAGE_COUNT; i++) {
+			ticks[i] += s->ticks[i];
+			calls[i] += s->calls[i];
+			allTicks += s->ticks[i];
+		}
+		for (int i = 0; i < COUNTER_COUNT; i++) counters[i] += s->counters[i];
+	}
+	double wall = std::chrono::duration<double>((stopped ? stopTime : std::chrono::steady_clock::now()) - startTime).count();
+	const double MB = 1024.0 * 1024.0;
+
+	printf("\n%-14s %10s %7s %10s %10s\n", "stage", "time (s)", "share", "calls", "avg (us)");
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		if (!calls[i]) continue;
+		double seconds = ticks[i] / rate;
+		printf("%-14s %10.3f %6.1f%% %10llu %10.2f\n", stageNames[i], seconds, allTicks ? 100.0 * ticks[i] / allTicks : 0.0,
+			(unsigned long long)calls[i], seconds * 1e6 / calls[i]);
+	}
+	printf("wall %.3f s, %d thread(s), %llu columns (%.0f columns/s)\n", wall, (int)slots.size(),
+		(unsigned long long)counters[COUNTER_COLUMNS], wall > 0 ? counters[COUNTER_COLUMNS] / wall : 0.0);
+	printf("read %.1f MB (%.1f MB/s), NBT %.1f MB -> %.1f MB compressed (%.2fx), wrote %.1f MB\n",
+		counters[COUNTER_BYTES_READ] / MB, wall > 0 ? counters[COUNTER_BYTES_READ] / MB / wall : 0.0,
+		counters[COUNTER_NBT_BYTES] / MB, counters[COUNTER_COMPRESSED_BYTES] / MB,
+		counters[COUNTER_COMPRESSED_BYTES] ? (double)counters[COUNTER_NBT_BYTES] / counters[COUNTER_COMPRESSED_BYTES] : 0.0,
+		counters[COUNTER_BYTES_WRITTEN] / MB);
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) printf("peak RSS %.1f MB\n", usage.ru_maxrss / 1024.0); // ru_maxrss is in KiB
+}
+
+bool Profiler::writeTrace(const char* path) {
+	FILE* f = fopen(path, "w");
+	if (!f) { printf("failed to create %s\n", path); return false; }
+	std::lock_guard<std::mutex> lock(slotsLock);
+	double perMicro = ticksPerSecond() / 1e6;
+	fprintf(f, "{\"traceEvents\":[\n");
+	bool first = true;
+	for (auto& s : slots) {
+		if (!s->name.empty()) {
+			fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", s->id, s->name.c_str());
+			first = false;
+		}
+		for (const TraceEvent& e : s->events) {
+			fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				first ? "" : ",\n", stageNames[e.stage], s->id, (e.begin - startTick) / perMicro, (e.end - e.begin) / perMicro);
+			first = false;
+		}
+	}
+	fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	return fclose(f) == 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+
+// Per-stage timing and counters for a conversion run. Each thread accumulates into its own slot, so
+// recording takes no lock; the slots are summed when the run is reported. Time is read with the
+// CPU cycle counter and converted with a rate measured over the run.
+// Off unless started: a disabled scope costs one branch
+
+enum ProfileStage {
+	STAGE_READ = 0,   // column and neighbour reads (mmap views or pread)
+	STAGE_PACK,       // id mapping, section packing and the height map
+	STAGE_LIGHT,
+	STAGE_DEDUP,      // content hashing and chunk cache lookups
+	STAGE_ENCODE,     // NBT encoding and payload framing, compression excluded
+	STAGE_COMPRESS,
+	STAGE_QUEUE_WAIT, // workers blocked on a full output queue
+	STAGE_WRITE,      // region placement, writes and closing
+	STAGE_WRITER_IDLE, // writer waiting for the workers
+	STAGE_COUNT
+};
+
+enum ProfileCounter {
+	COUNTER_COLUMNS = 0,    // columns read
+	COUNTER_BYTES_READ,     // Eden bytes read (columns and their light neighbours)
+	COUNTER_NBT_BYTES,      // chunk NBT encoded, before compression
+	COUNTER_COMPRESSED_BYTES, // the same after compression
+	COUNTER_BYTES_WRITTEN,  // region payload bytes handed to the I/O layer
+	COUNTER_COUNT
+};
+
+class Profiler {
+public:
+	// Clear everything and start recording; with trace every scope is also kept as a trace event
+	static void start(bool trace);
+	// Stop recording (totals stay available for the report)
+	static void stop();
+	static bool enabled() { return on; }
+
+	// Label of the calling thread in the trace
+	static void nameThread(const char* name);
+	static void count(ProfileCounter counter, uint64_t n);
+
+	// Table of time per stage (summed over threads, nested scopes excluded), throughput,
+	// compression ratio and peak RSS
+	static void printSummary();
+	// Chrome trace event JSON (chrome://tracing, ui.perfetto.dev); false if it can't be written
+	static bool writeTrace(const char* path);
+
+	struct ThreadSlot; // what one thread recorded, defined in Profiler.cpp
+
+private:
+	friend class ProfileScope;
+	static ThreadSlot* slot();
+	static bool on;
+	static bool tracing;
+};
+
+// Times its lifetime as stage on the calling thread. Time spent in scopes opened inside it
+// counts for those scopes only
+class ProfileScope {
+public:
+	explicit ProfileScope(ProfileStage stage);
+	~ProfileScope();
+
+private:
+	Profiler::ThreadSlot* thread;
+	ProfileScope* parent;
+	ProfileStage stage;
+	uint64_t begin;
+	uint64_t nested;
+};
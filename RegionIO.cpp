@@ -0,0 +1,306 @@
+#include "RegionIO.h"
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// opt-in, since it needs -luring at link time
+#if defined(EDEN_WITH_URING) && defined(__has_include)
+#if __has_include(<liburing.h>)
+#define EDEN_HAVE_URING 1
+#include <liburing.h>
+#endif
+#endif
+
+static const size_t MAX_BATCH_BYTES = 8 << 20;     // one pwritev covers at most 8 MiB
+static const size_t MAX_BATCH_BUFFERS = 256;       // and at most this many payloads (well under IOV_MAX)
+static const size_t MAX_QUEUED_BYTES = 64 << 20;   // the writer blocks once this much is waiting for disk
+static const size_t MAX_SPARES = 2 * MAX_BATCH_BUFFERS; // enough to refill a whole batch, so buffers stop being allocated
+
+void RegionIO::write(int fd, long long offset, std::vector<uint8_t>&& buf) {
+	if (buf.empty()) return;
+	bool extends = pending.fd == fd && pending.offset + (long long)pending.bytes == offset;
+	if (!pending.bufs.empty() && (!extends || pending.bytes + buf.size() > MAX_BATCH_BYTES || pending.bufs.size() >= MAX_BATCH_BUFFERS)) {
+		dispatch();
+	}
+	if (pending.bufs.empty()) {
+		pending.fd = fd;
+		pending.offset = offset;
+		pending.bytes = 0;
+	}
+	pending.bytes += buf.size();
+	pending.bufs.push_back(std::move(buf));
+}
+
+void RegionIO::dispatch() {
+	if (pending.bufs.empty()) return;
+	submit(std::move(pending));
+	pending = Batch();
+}
+
+bool RegionIO::flush() {
+	dispatch();
+	wait();
+	std::lock_guard<std::mutex> lock(m);
+	bool ok = !anyFailed;
+	anyFailed = false;
+	return ok;
+}
+
+bool RegionIO::failed(int fd) {
+	std::lock_guard<std::mutex> lock(m);
+	return failedFds.count(fd) != 0;
+}
+
+void RegionIO::forget(int fd) {
+	std::lock_guard<std::mutex> lock(m);
+	failedFds.erase(fd);
+}
+
+bool RegionIO::reclaim(std::vector<uint8_t>& buf) {
+	std::lock_guard<std::mutex> lock(m);
+	if (spares.empty()) return false;
+	buf = std::move(spares.back());
+	spares.pop_back();
+	return true;
+}
+
+bool RegionIO::writeBatch(const Batch& batch, size_t skip) {
+	long long offset = batch.offset + (long long)skip;
+	std::vector<iovec> iov;
+	iov.reserve(batch.bufs.size());
+	for (const auto& b : batch.bufs) {
+		if (skip >= b.size()) { skip -= b.size(); continue; }
+		iovec v;
+		v.iov_base = const_cast<uint8_t*>(b.data()) + skip;
+		v.iov_len = b.size() - skip;
+		iov.push_back(v);
+		skip = 0;
+	}
+	size_t first = 0;
+	while (first < iov.size()) {
+		ssize_t n = pwritev(batch.fd, iov.data() + first, (int)(iov.size() - first), (off_t)offset);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		if (n == 0) return false;
+		offset += n;
+		// advance past what was written; a short write resumes mid-buffer
+		size_t left = (size_t)n;
+		while (first < iov.size() && left >= iov[first].iov_len) left -= iov[first++].iov_len;
+		if (left) {
+			iov[first].iov_base = (uint8_t*)iov[first].iov_base + left;
+			iov[first].iov_len -= left;
+		}
+	}
+	return true;
+}
+
+void RegionIO::complete(Batch& batch, bool ok) {
+	std::lock_guard<std::mutex> lock(m);
+	if (!ok) {
+		failedFds.insert(batch.fd);
+		anyFailed = true;
+	}
+	for (auto& b : batch.bufs) {
+		if (spares.size() >= MAX_SPARES) break;
+		spares.push_back(std::move(b));
+	}
+	batch.bufs.clear();
+}
+
+// Writes on the calling (writer) thread
+class SyncRegionIO : public RegionIO {
+public:
+	~SyncRegionIO() { flush(); }
+	RegionIOBackend backend() const override { return REGION_IO_SYNC; }
+
+protected:
+	void submit(Batch&& batch) override {
+		bool ok = writeBatch(batch, 0);
+		complete(batch, ok);
+	}
+	void wait() override {}
+};
+
+// Each file is always handled by the same thread, so writes to one file stay in order
+// (a rewritten chunk can reuse sectors that an earlier, still queued write targets)
+class ThreadRegionIO : public RegionIO {
+public:
+	explicit ThreadRegionIO(int threads): queued(0), busy(0), stopping(false), lanes(threads < 1 ? 1 : threads) {
+		for (size_t i = 0; i < lanes.size(); i++) pool.emplace_back([this, i] { run(i); });
+	}
+	~ThreadRegionIO() {
+		flush();
+		{
+			std::lock_guard<std::mutex> lock(qm);
+			stopping = true;
+		}
+		more.notify_all();
+		for (auto& t : pool) t.join();
+	}
+	RegionIOBackend backend() const override { return REGION_IO_THREADS; }
+
+protected:
+	void submit(Batch&& batch) override {
+		std::unique_lock<std::mutex> lock(qm);
+		less.wait(lock, [&] { return queued == 0 || queued + batch.bytes <= MAX_QUEUED_BYTES; });
+		queued += batch.bytes;
+		lanes[(size_t)batch.fd % lanes.size()].push_back(std::move(batch));
+		more.notify_all();
+	}
+	void wait() override {
+		std::unique_lock<std::mutex> lock(qm);
+		less.wait(lock, [&] { return queued == 0 && busy == 0; });
+	}
+
+private:
+	void run(size_t lane) {
+		std::unique_lock<std::mutex> lock(qm);
+		while (true) {
+			more.wait(lock, [&] { return stopping || !lanes[lane].empty(); });
+			if (lanes[lane].empty()) return;
+			Batch batch = std::move(lanes[lane].front());
+			lanes[lane].pop_front();
+			busy++;
+			lock.unlock();
+			size_t bytes = batch.bytes;
+			bool ok = writeBatch(batch, 0);
+			complete(batch, ok);
+			lock.lock();
+			busy--;
+			queued -= bytes;
+			less.notify_all();
+		}
+	}
+
+	std::mutex qm;
+	std::condition_variable more, less;
+	size_t queued;
+	int busy;
+	bool stopping;
+	std::vector<std::deque<Batch>> lanes;
+	std::vector<std::thread> pool;
+};
+
+#ifdef EDEN_HAVE_URING
+// Batches become writev requests on one ring, submitted and reaped by the writer thread.
+// A batch overlapping one still in flight on the same file waits for it, which keeps
+// rewrites ordered
+class UringRegionIO : public RegionIO {
+public:
+	UringRegionIO(): inflight(0) {
+		ready = io_uring_queue_init(QUEUE_DEPTH, &ring, 0) == 0;
+		slots.resize(QUEUE_DEPTH);
+	}
+	~UringRegionIO() {
+		if (!ready) return;
+		flush();
+		io_uring_queue_exit(&ring);
+	}
+	bool isReady() const { return ready; }
+	RegionIOBackend backend() const override { return REGION_IO_URING; }
+
+protected:
+	void submit(Batch&& batch) override {
+		while (inflight == QUEUE_DEPTH || overlapsInFlight(batch)) reapOne();
+		Slot* slot = nullptr;
+		for (auto& s : slots) if (!s.busy) { slot = &s; break; }
+		io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+		if (!slot || !sqe) {
+			bool ok = writeBatch(batch, 0);
+			complete(batch, ok);
+			return;
+		}
+		slot->batch = std::move(batch);
+		slot->iov.clear();
+		for (auto& b : slot->batch.bufs) {
+			iovec v;
+			v.iov_base = b.data();
+			v.iov_len = b.size();
+			slot->iov.push_back(v);
+		}
+		slot->busy = true;
+		io_uring_prep_writev(sqe, slot->batch.fd, slot->iov.data(), (unsigned)slot->iov.size(), (__u64)slot->batch.offset);
+		io_uring_sqe_set_data(sqe, slot);
+		io_uring_submit(&ring);
+		inflight++;
+	}
+	void wait() override {
+		while (inflight) reapOne();
+	}
+
+private:
+	static const unsigned QUEUE_DEPTH = 32;
+
+	struct Slot {
+		bool busy = false;
+		Batch batch;
+		std::vector<iovec> iov;
+	};
+
+	bool overlapsInFlight(const Batch& b) const {
+		for (const auto& s : slots) {
+			if (!s.busy || s.batch.fd != b.fd) continue;
+			if (b.offset < s.batch.offset + (long long)s.batch.bytes && s.batch.offset < b.offset + (long long)b.bytes) return true;
+		}
+		return false;
+	}
+
+	void reapOne() {
+		io_uring_cqe* cqe = nullptr;
+		int rv = io_uring_wait_cqe(&ring, &cqe);
+		if (rv == -EINTR) return;
+		if (rv < 0 || !cqe) return;
+		Slot* slot = (Slot*)io_uring_cqe_get_data(cqe);
+		int res = cqe->res;
+		io_uring_cqe_seen(&ring, cqe);
+		bool ok = res >= 0;
+		// finish a short write synchronously
+		if (ok && (size_t)res < slot->batch.bytes) ok = writeBatch(slot->batch, (size_t)res);
+		complete(slot->batch, ok);
+		slot->busy = false;
+		inflight--;
+	}
+
+	io_uring ring;
+	bool ready;
+	unsigned inflight;
+	std::vector<Slot> slots;
+};
+#endif
+
+RegionIO* RegionIO::create(RegionIOBackend backend, int threads) {
+	switch (backend) {
+	case REGION_IO_SYNC: return new SyncRegionIO();
+	case REGION_IO_THREADS: return new ThreadRegionIO(threads);
+	default: break;
+	}
+#ifdef EDEN_HAVE_URING
+	UringRegionIO* uring = new UringRegionIO();
+	if (uring->isReady()) return uring;
+	delete uring;
+#endif
+	return new ThreadRegionIO(threads);
+}
+
+bool parseRegionIOBackend(const char* text, RegionIOBackend& out) {
+	if (strcmp(text, "auto") == 0) out = REGION_IO_AUTO;
+	else if (strcmp(text, "sync") == 0) out = REGION_IO_SYNC;
+	else if (strcmp(text, "threads") == 0) out = REGION_IO_THREADS;
+	else if (strcmp(text, "uring") == 0) out = REGION_IO_URING;
+	else return false;
+	return true;
+}
+
+const char* regionIOBackendName(RegionIOBackend backend) {
+	switch (backend) {
+	case REGION_IO_SYNC: return "sync";
+	case REGION_IO_THREADS: return "threads";
+	case REGION_IO_URING: return "io_uring";
+	default: return "auto";
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// Output layer for region files. The writer hands over sector aligned payload buffers;
+// consecutive buffers for the same file are coalesced into one pwritev (or one io_uring writev),
+// so a run of chunks costs a single call instead of one per chunk
+
+enum RegionIOBackend {
+	REGION_IO_AUTO = 0, // io_uring if available, else the thread pool
+	REGION_IO_SYNC,     // pwritev on the calling thread
+	REGION_IO_THREADS,  // pwritev on background threads
+	REGION_IO_URING     // io_uring (Linux; build with -DEDEN_WITH_URING and link with -luring)
+};
+
+// Parse "auto", "sync", "threads", "uring"; false if the text is not understood
+bool parseRegionIOBackend(const char* text, RegionIOBackend& out);
+const char* regionIOBackendName(RegionIOBackend backend);
+
+class RegionIO {
+public:
+	virtual ~RegionIO() {}
+
+	// Queue buf to be written at offset in fd. The buffer belongs to the I/O layer until it
+	// comes back from reclaim(). Writes to the same file are never reordered
+	void write(int fd, long long offset, std::vector<uint8_t>&& buf);
+
+	// Wait until every queued write is done; false if any write failed
+	bool flush();
+
+	// A write to fd failed; call after flush()
+	bool failed(int fd);
+
+	// Drop per-file state before fd is closed (the caller flushes first)
+	void forget(int fd);
+
+	// A buffer whose write completed, for reuse; false if there is none
+	bool reclaim(std::vector<uint8_t>& buf);
+
+	virtual RegionIOBackend backend() const = 0;
+
+	// AUTO (and URING when io_uring can't be set up) falls back to the thread pool
+	static RegionIO* create(RegionIOBackend backend, int threads);
+
+protected:
+	struct Batch {
+		int fd = -1;
+		long long offset = 0;
+		size_t bytes = 0;
+		std::vector<std::vector<uint8_t>> bufs;
+	};
+
+	// Start writing a batch; may block while too much is in flight
+	virtual void submit(Batch&& batch) = 0;
+	// Block until every submitted batch is complete
+	virtual void wait() = 0;
+
+	// Write a batch (after its first skip bytes) with pwritev, resuming short writes
+	static bool writeBatch(const Batch& batch, size_t skip);
+	// Record the result of a batch and keep its buffers for reclaim()
+	void complete(Batch& batch, bool ok);
+
+private:
+	void dispatch();
+
+	Batch pending; // contiguous run being collected, owned by the writer thread
+	std::mutex m;
+	std::set<int> failedFds;
+	bool anyFailed = false;
+	std::vector<std::vector<uint8_t>> spares;
+};
@@ -0,0 +1,332 @@
+#include "SectionPack.h"
+#include "BlockMap.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define SECTIONPACK_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(SECTIONPACK_SSE2) && defined(__GNUC__)
+#define SECTIONPACK_AVX2 1
+#include <immintrin.h>
+#endif
+
+static const int N = 16;
+static const int SECTION_VOXELS = N * N * N;
+
+// Id and meta split into separate 256-byte tables so both can be used as byte shuffles
+struct PackTable {
+	alignas(32) uint8_t id[256];
+	alignas(32) uint8_t meta[256];
+	uint16_t groups; // bit h set if any id in h*16..h*16+15 maps to something other than air/0
+	bool signedAir;  // exactly the ids <= 0 map to air/0 (Eden's zero and negative ids)
+};
+
+static PackTable buildPackTable() {
+	PackTable t;
+	const MCMapping* table = edenToMinecraftTable();
+	t.groups = 0;
+	t.signedAir = true;
+	for (int i = 0; i < 256; i++) {
+		t.id[i] = table[i].id;
+		t.meta[i] = table[i].meta & 0x0F;
+		bool air = !t.id[i] && !t.meta[i];
+		if (!air) t.groups |= (uint16_t)(1 << (i >> 4));
+		if (air != ((int8_t)i <= 0)) t.signedAir = false;
+	}
+	return t;
+}
+
+static const PackTable& packTable() {
+	static const PackTable t = buildPackTable();
+	return t;
+}
+
+static void packScalar(const int8_t* src, uint8_t* blocks, uint8_t* data) {
+	const PackTable& t = packTable();
+	for (int y = 0; y < N; y++) {
+		for (int z = 0; z < N; z++) {
+			int row = (y * N + z) * N; // Y,Z,X order expected by Anvil arrays
+			for (int x = 0; x < N; x += 2) {
+				uint8_t a = (uint8_t)src[x * N * N + z * N + y];
+				uint8_t b = (uint8_t)src[(x + 1) * N * N + z * N + y];
+				blocks[row + x] = t.id[a];
+				blocks[row + x + 1] = t.id[b];
+				// even x in the low nibble, odd x in the high nibble
+				data[(row + x) >> 1] = (uint8_t)(t.meta[a] | (t.meta[b] << 4));
+			}
+		}
+	}
+}
+
+#ifdef SECTIONPACK_SSE2
+
+// 16x16 byte transpose in four perfect-shuffle rounds: each round rotates the
+// (register, byte) index bits by one, so after four rows and columns have swapped
+static inline void transpose16(__m128i r[16]) {
+#if defined(__GNUC__)
+#pragma GCC unroll 4
+#endif
+	for (int round = 0; round < 4; round++) {
+		__m128i t[16];
+#if defined(__GNUC__)
+#pragma GCC unroll 8
+#endif
+		for (int k = 0; k < 8; k++) {
+			t[2 * k] = _mm_unpacklo_epi8(r[k], r[k + 8]);
+			t[2 * k + 1] = _mm_unpackhi_epi8(r[k], r[k + 8]);
+		}
+		for (int k = 0; k < 16; k++) r[k] = t[k];
+	}
+}
+
+// 16 meta bytes (x = 0..15) -> 8 Data bytes, even x low nibble, odd x high nibble
+static inline __m128i packNibbles(__m128i m) {
+	__m128i lo = _mm_and_si128(m, _mm_set1_epi16(0x000F));
+	__m128i hi = _mm_and_si128(_mm_srli_epi16(m, 4), _mm_set1_epi16(0x00F0));
+	return _mm_packus_epi16(_mm_or_si128(lo, hi), _mm_setzero_si128());
+}
+
+// Transpose one section of bytes from X,Z,Y to Y,Z,X order
+static void transposeSection(const uint8_t* in, uint8_t* out) {
+	for (int z = 0; z < N; z++) {
+		__m128i r[16];
+		for (int x = 0; x < N; x++) r[x] = _mm_loadu_si128((const __m128i*)(in + x * N * N + z * N));
+		transpose16(r);
+		for (int y = 0; y < N; y++) _mm_storeu_si128((__m128i*)(out + (y * N + z) * N), r[y]);
+	}
+}
+
+// SSE2 has no byte shuffle, so the raw ids are transposed first and the table lookup
+// and nibble packing then run as one sequential scalar pass
+static void packSSE2(const int8_t* src, uint8_t* blocks, uint8_t* data) {
+	const PackTable& t = packTable();
+	alignas(16) uint8_t ids[SECTION_VOXELS];
+	transposeSection((const uint8_t*)src, ids);
+	for (int i = 0; i < SECTION_VOXELS; i += 2) {
+		uint8_t a = ids[i], b = ids[i + 1];
+		blocks[i] = t.id[a];
+		blocks[i + 1] = t.id[b];
+		data[i >> 1] = (uint8_t)(t.meta[a] | (t.meta[b] << 4));
+	}
+}
+
+#endif
+
+#ifdef SECTIONPACK_AVX2
+
+// Table lookup with vpshufb, 16 table entries per shuffle. For group h, (v ^ h<<4) +sat 0x70
+// keeps bit 7 clear only for bytes whose high nibble is h, and vpshufb zeroes every other byte.
+// Groups that map entirely to air are skipped
+__attribute__((target("avx2")))
+static void packAVX2(const int8_t* src, uint8_t* blocks, uint8_t* data) {
+	const PackTable& t = packTable();
+	alignas(32) uint8_t ids[SECTION_VOXELS];
+	alignas(32) uint8_t metas[SECTION_VOXELS];
+
+	__m256i idTab[16], metaTab[16];
+	int groups[16], ngroups = 0;
+	for (int h = 0; h < 16; h++) {
+		if (!(t.groups & (1 << h))) continue;
+		idTab[ngroups] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)(t.id + h * 16)));
+		metaTab[ngroups] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)(t.meta + h * 16)));
+		groups[ngroups++] = h;
+	}
+	const __m256i bias = _mm256_set1_epi8(0x70);
+
+	for (int i = 0; i < SECTION_VOXELS; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+		__m256i id = _mm256_setzero_si256();
+		__m256i meta = _mm256_setzero_si256();
+		for (int g = 0; g < ngroups; g++) {
+			__m256i idx = _mm256_adds_epu8(_mm256_xor_si256(v, _mm256_set1_epi8((char)(groups[g] << 4))), bias);
+			id = _mm256_or_si256(id, _mm256_shuffle_epi8(idTab[g], idx));
+			meta = _mm256_or_si256(meta, _mm256_shuffle_epi8(metaTab[g], idx));
+		}
+		_mm256_store_si256((__m256i*)(ids + i), id);
+		_mm256_store_si256((__m256i*)(metas + i), meta);
+	}
+
+	transposeSection(ids, blocks);
+	for (int z = 0; z < N; z++) {
+		__m128i r[16];
+		for (int x = 0; x < N; x++) r[x] = _mm_loadu_si128((const __m128i*)(metas + x * N * N + z * N));
+		transpose16(r);
+		for (int y = 0; y < N; y++) _mm_storel_epi64((__m128i*)(data + ((y * N + z) * N >> 1)), packNibbles(r[y]));
+	}
+}
+
+#endif
+
+// Bit x set for every non-air block in the 16 block X row
+static inline unsigned rowSolidMask(const uint8_t* row) {
+#ifdef SECTIONPACK_SSE2
+	__m128i v = _mm_loadu_si128((const __m128i*)row);
+	return ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) & 0xFFFF;
+#else
+	unsigned m = 0;
+	for (int x = 0; x < N; x++) m |= (unsigned)(row[x] != 0) << x;
+	return m;
+#endif
+}
+
+void buildHeightMap(const uint8_t* const* sectionBlocks, int sections, int32_t* heightMap) {
+	for (int i = 0; i < N * N; i++) heightMap[i] = 0;
+	unsigned open[N]; // bit x set while x,z has no height yet
+	unsigned anyOpen = 0xFFFF; // bit z set while row z has open columns
+	for (int z = 0; z < N; z++) open[z] = 0xFFFF;
+	for (int s = sections - 1; s >= 0 && anyOpen; s--) {
+		const uint8_t* blocks = sectionBlocks[s];
+		if (!blocks) continue;
+		for (int y = N - 1; y >= 0 && anyOpen; y--) {
+			for (int z = 0; z < N; z++) {
+				if (!open[z]) continue;
+				unsigned hit = rowSolidMask(blocks + (y * N + z) * N) & open[z];
+				if (!hit) continue;
+				open[z] &= ~hit;
+				if (!open[z]) anyOpen &= ~(1u << z);
+				int32_t h = s * N + y + 1;
+				for (int x = 0; x < N; x++) {
+					if (hit & (1u << x)) heightMap[z * N + x] = h;
+				}
+			}
+		}
+	}
+}
+
+bool sectionIsAir(const int8_t* edenBlocks) {
+	const PackTable& t = packTable();
+	if (!t.signedAir) {
+		// the mapping changed shape: look every block up
+		const uint8_t* p = (const uint8_t*)edenBlocks;
+		for (int i = 0; i < SECTION_VOXELS; i++) {
+			if (t.id[p[i]] || t.meta[p[i]]) return false;
+		}
+		return true;
+	}
+#ifdef SECTIONPACK_SSE2
+	// a block is any byte > 0 as a signed compare
+	const __m128i* p = (const __m128i*)edenBlocks;
+	const __m128i zero = _mm_setzero_si128();
+	for (int i = 0; i < SECTION_VOXELS / 16; i += 16) {
+		__m128i acc = _mm_cmpgt_epi8(_mm_loadu_si128(p + i), zero);
+		for (int k = 1; k < 16; k++) acc = _mm_or_si128(acc, _mm_cmpgt_epi8(_mm_loadu_si128(p + i + k), zero));
+		if (_mm_movemask_epi8(acc)) return false;
+	}
+	return true;
+#else
+	for (int i = 0; i < SECTION_VOXELS; i += 256) {
+		bool solid = false;
+		for (int k = 0; k < 256; k++) solid |= edenBlocks[i + k] > 0;
+		if (solid) return false;
+	}
+	return true;
+#endif
+}
+
+bool sectionPackKernelSupported(SectionPackKernel kernel) {
+	switch (kernel) {
+	case PACK_SCALAR: return true;
+#ifdef SECTIONPACK_SSE2
+	case PACK_SSE2: return true;
+#endif
+#ifdef SECTIONPACK_AVX2
+	case PACK_AVX2: return __builtin_cpu_supports("avx2");
+#endif
+	default: return false;
+	}
+}
+
+SectionPackKernel bestSectionPackKernel() {
+	// not SSE2: it loses to the scalar kernel (see SectionPackBench)
+	static const SectionPackKernel best = sectionPackKernelSupported(PACK_AVX2) ? PACK_AVX2 : PACK_SCALAR;
+	return best;
+}
+
+const char* sectionPackKernelName(SectionPackKernel kernel) {
+	switch (kernel) {
+	case PACK_SSE2: return "sse2";
+	case PACK_AVX2: return "avx2";
+	default: return "scalar";
+	}
+}
+
+void packSectionWith(SectionPackKernel kernel, const int8_t* edenBlocks, uint8_t* blocks, uint8_t* data) {
+	if (!sectionPackKernelSupported(kernel)) kernel = PACK_SCALAR;
+	switch (kernel) {
+#ifdef SECTIONPACK_AVX2
+	case PACK_AVX2: packAVX2(edenBlocks, blocks, data); return;
+#endif
+#ifdef SECTIONPACK_SSE2
+	case PACK_SSE2: packSSE2(edenBlocks, blocks, data); return;
+#endif
+	default: packScalar(edenBlocks, blocks, data); return;
+	}
+}
+
+void packSection(const int8_t* edenBlocks, uint8_t* blocks, uint8_t* data) {
+	packSectionWith(bestSectionPackKernel(), edenBlocks, blocks, data);
+}
+
+// Every block the same id and meta: the common solid or single-material section
+static bool sectionIsUniform(const uint8_t* blocks, const uint8_t* data) {
+	uint8_t d = data[0];
+	if ((d & 0x0F) != (d >> 4)) return false;
+#ifdef SECTIONPACK_SSE2
+	const __m128i b = _mm_set1_epi8((char)blocks[0]);
+	const __m128i m = _mm_set1_epi8((char)d);
+	__m128i eq = _mm_set1_epi8(-1);
+	for (int i = 0; i < SECTION_VOXELS; i += 16) eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(blocks + i)), b));
+	for (int i = 0; i < SECTION_VOXELS / 2; i += 16) eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(data + i)), m));
+	return _mm_movemask_epi8(eq) == 0xFFFF;
+#else
+	for (int i = 1; i < SECTION_VOXELS; i++) if (blocks[i] != blocks[0]) return false;
+	for (int i = 1; i < SECTION_VOXELS / 2; i++) if (data[i] != d) return false;
+	return true;
+#endif
+}
+
+int buildPalette(const uint8_t* blocks, const uint8_t* data, uint16_t* palette, uint16_t* indices) {
+	if (sectionIsUniform(blocks, data)) {
+		palette[0] = (uint16_t)(blocks[0] << 4 | (data[0] & 0x0F));
+		for (int i = 0; i < SECTION_VOXELS; i++) indices[i] = 0;
+		return 1;
+	}
+	// palette position + 1 per state, 0 = not seen yet; only the used slots are cleared afterwards
+	static thread_local uint16_t slot[256 * 16] = {};
+	int size = 0;
+	for (int i = 0; i < SECTION_VOXELS; i += 2) {
+		uint8_t d = data[i >> 1];
+		int a = blocks[i] << 4 | (d & 0x0F);
+		int b = blocks[i + 1] << 4 | (d >> 4);
+		if (!slot[a]) { palette[size] = (uint16_t)a; slot[a] = (uint16_t)++size; }
+		if (!slot[b]) { palette[size] = (uint16_t)b; slot[b] = (uint16_t)++size; }
+		indices[i] = slot[a] - 1;
+		indices[i + 1] = slot[b] - 1;
+	}
+	for (int p = 0; p < size; p++) slot[palette[p]] = 0;
+	return size;
+}
+
+int packBlockStates(const uint16_t* indices, int paletteSize, int64_t* out) {
+	int bits = 4;
+	while ((1 << bits) < paletteSize) bits++;
+	if (bits == 4) {
+		// 16 values per long, value k in bits 4k..4k+3: on a little-endian (x86) host that is the
+		// byte layout of Data nibbles, so the nibble packing of the section kernels builds each long
+#ifdef SECTIONPACK_SSE2
+		for (int i = 0; i < SECTION_VOXELS; i += 16) {
+			__m128i v = _mm_packus_epi16(_mm_loadu_si128((const __m128i*)(indices + i)), _mm_loadu_si128((const __m128i*)(indices + i + 8)));
+			_mm_storel_epi64((__m128i*)(out + i / 16), packNibbles(v));
+		}
+		return SECTION_VOXELS / 16;
+#endif
+	}
+	int perLong = 64 / bits;
+	int longs = (SECTION_VOXELS + perLong - 1) / perLong;
+	for (int k = 0, i = 0; k < longs; k++) {
+		uint64_t v = 0;
+		for (int j = 0; j < perLong && i < SECTION_VOXELS; j++, i++) v |= (uint64_t)indices[i] << (j * bits);
+		out[k] = (int64_t)v;
+	}
+	return longs;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+
+// Section packing: map one 16x16x16 Eden chunk (x,z,y order) to an Anvil section (y,z,x order).
+// Writes 4096 block ids and 2048 bytes of Data nibbles; every output byte is written.
+// The AVX2 kernel is picked at runtime where the CPU has it, else the scalar kernel (the reference).
+// The SSE2 kernel only stays for comparison: its transpose costs more than the strided reads it
+// saves, so it packs slower than the scalar kernel.
+
+enum SectionPackKernel {
+	PACK_SCALAR = 0,
+	PACK_SSE2,
+	PACK_AVX2
+};
+
+// Fastest kernel this CPU supports (decided once): AVX2 or scalar
+SectionPackKernel bestSectionPackKernel();
+bool sectionPackKernelSupported(SectionPackKernel kernel);
+const char* sectionPackKernelName(SectionPackKernel kernel);
+
+// True if every block of the Eden chunk maps to air (id 0 and negative ids), so the section can be
+// omitted. Checks 256 bytes per step and stops at the first block found
+bool sectionIsAir(const int8_t* edenBlocks);
+
+void packSection(const int8_t* edenBlocks, uint8_t* blocks, uint8_t* data);
+
+// Anvil HeightMap (one past the topmost non-air block, 0 if none) for x,z at z*16+x, from packed
+// sections (nullptr = absent, index = section Y). Whole 16-block X rows are tested at once, from
+// the top down, until every x,z has found its block
+void buildHeightMap(const uint8_t* const* sectionBlocks, int sections, int32_t* heightMap);
+void packSectionWith(SectionPackKernel kernel, const int8_t* edenBlocks, uint8_t* blocks, uint8_t* data);
+
+// Palette form of a packed section for 1.13+ chunks. palette gets the distinct states
+// (id << 4 | meta) in order of first appearance, indices the palette position of every block in
+// section order. A section of a single state is recognised without the per-block lookup.
+// Returns the palette size
+int buildPalette(const uint8_t* blocks, const uint8_t* data, uint16_t* palette, uint16_t* indices);
+
+// BlockStates long array of a palette section (1.16 layout: max(4, bits the palette needs) bits
+// per block, low bits first, no value split across two longs). Returns the number of longs
+int packBlockStates(const uint16_t* indices, int paletteSize, int64_t* out);
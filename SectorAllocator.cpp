@@ -0,0 +1,109 @@
+#include "SectorAllocator.h"
+
+static const uint32_t HEADER_SECTORS = 2;
+static const uint32_t NONE = 0xFFFFFFFFu;
+
+static inline int ctz64(uint64_t v) {
+#if defined(__GNUC__)
+	return __builtin_ctzll(v);
+#else
+	int n = 0;
+	while (!(v & 1)) { v >>= 1; n++; }
+	return n;
+#endif
+}
+
+SectorAllocator::SectorAllocator() {
+	reset();
+}
+
+void SectorAllocator::reset() {
+	bits.assign(1, 0);
+	setRange(0, HEADER_SECTORS, true);
+	endSector = HEADER_SECTORS;
+	freeBelowEnd = 0;
+}
+
+void SectorAllocator::setRange(uint32_t first, uint32_t count, bool used) {
+	uint32_t last = first + count;
+	if (((last + 63) >> 6) > bits.size()) bits.resize((last + 63) >> 6, 0);
+	for (uint32_t s = first; s < last; ) {
+		uint32_t bit = s & 63;
+		uint32_t n = 64 - bit;
+		if (n > last - s) n = last - s;
+		uint64_t mask = (n == 64) ? ~0ULL : (((1ULL << n) - 1) << bit);
+		if (used) bits[s >> 6] |= mask; else bits[s >> 6] &= ~mask;
+		s += n;
+	}
+}
+
+// Next sector >= s (and below endSector) whose bit equals used, or endSector.
+// Whole words are skipped at once, the bit inside a word is found with ctz
+uint32_t SectorAllocator::nextWith(uint32_t s, bool used) const {
+	while (s < endSector) {
+		uint64_t w = bits[s >> 6];
+		if (!used) w = ~w;
+		w &= ~0ULL << (s & 63);
+		if (w) {
+			uint32_t found = (s & ~63u) + (uint32_t)ctz64(w);
+			return found < endSector ? found : endSector;
+		}
+		s = (s & ~63u) + 64;
+	}
+	return endSector;
+}
+
+uint32_t SectorAllocator::findFree(uint32_t count) const {
+	uint32_t s = HEADER_SECTORS;
+	while (s < endSector) {
+		uint32_t start = nextWith(s, false);
+		if (start >= endSector) break;
+		uint32_t stop = nextWith(start, true);
+		if (stop - start >= count) return start;
+		s = stop;
+	}
+	return NONE;
+}
+
+uint32_t SectorAllocator::allocate(uint32_t count) {
+	// the bitmap is only searched when a fitting gap can exist
+	if (freeBelowEnd >= count) {
+		uint32_t first = findFree(count);
+		if (first != NONE) {
+			setRange(first, count, true);
+			freeBelowEnd -= count;
+			return first;
+		}
+	}
+	uint32_t first = endSector;
+	setRange(first, count, true);
+	endSector += count;
+	return first;
+}
+
+void SectorAllocator::claim(uint32_t first, uint32_t count) {
+	uint32_t last = first + count;
+	// sectors already counted as free gaps become used
+	for (uint32_t s = first; s < last && s < endSector; s++) {
+		if (!isUsed(s)) freeBelowEnd--;
+	}
+	if (last > endSector) {
+		// anything skipped between the old end and this run is a gap
+		if (first > endSector) freeBelowEnd += first - endSector;
+		endSector = last;
+	}
+	setRange(first, count, true);
+}
+
+void SectorAllocator::release(uint32_t first, uint32_t count) {
+	if (first < HEADER_SECTORS || first + count > endSector) return;
+	for (uint32_t s = first; s < first + count; s++) {
+		if (isUsed(s)) freeBelowEnd++;
+	}
+	setRange(first, count, false);
+	// a freed tail shrinks the file instead of leaving a gap
+	while (endSector > HEADER_SECTORS && !isUsed(endSector - 1)) {
+		endSector--;
+		freeBelowEnd--;
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Sector allocator for a region file (4 KiB sectors, sectors 0 and 1 hold the header).
+// Fresh regions are filled by bumping an end pointer; sectors freed by rewrites are tracked in a
+// word-level bitmap that is only searched while enough free sectors exist below the end.
+
+class SectorAllocator {
+public:
+	SectorAllocator();
+
+	// Forget everything; only the two header sectors are in use
+	void reset();
+
+	// First sector of a run of count free sectors
+	uint32_t allocate(uint32_t count);
+
+	// Mark [first, first+count) as in use, e.g. when rebuilding from an existing header
+	void claim(uint32_t first, uint32_t count);
+
+	void release(uint32_t first, uint32_t count);
+
+	// One past the last sector in use (the file needs no more than this many sectors)
+	uint32_t end() const { return endSector; }
+
+private:
+	bool isUsed(uint32_t s) const { return (bits[s >> 6] >> (s & 63)) & 1; }
+	void setRange(uint32_t first, uint32_t count, bool used);
+	uint32_t nextWith(uint32_t s, bool used) const;
+	uint32_t findFree(uint32_t count) const;
+
+	std::vector<uint64_t> bits; // 1 = used, covers [0, endSector)
+	uint32_t endSector;
+	uint32_t freeBelowEnd;      // free sectors inside [2, endSector)
+};
@@ -0,0 +1,84 @@
+// ContentHasher checked against known XXH64 answers (from the reference implementation), then timed
+// on column-sized input
+// build: g++ -O2 -std=c++11 -I.. ContentHashBench.cpp ../ChunkCache.cpp -o contenthash_bench
+// usage: contenthash_bench [columns]; exits 1 on the first wrong hash
+
+#include "ChunkCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static const int COLUMN_BLOCKS = 16 * 16 * 16 * 4;
+
+// Bytes (i * 31 + 7) & 0xff, for the lengths around every stripe and tail boundary
+static std::vector<uint8_t> pattern(size_t n) {
+	std::vector<uint8_t> v(n);
+	for (size_t i = 0; i < n; i++) v[i] = (uint8_t)(i * 31 + 7);
+	return v;
+}
+
+struct KnownAnswer {
+	const char* text; // nullptr: pattern(length)
+	size_t length;
+	uint64_t lo, hi; // XXH64 with CONTENT_HASH_SEEDS[0] and [1]
+};
+
+static const KnownAnswer answers[] = {
+	{ "", 0, 0xEF46DB3751D8E999ULL, 0xC4349FC93C010000ULL },
+	{ "a", 1, 0xD24EC4F1A98C6E5BULL, 0x9A7C6D2EA45568C9ULL },
+	{ "abc", 3, 0x44BC2CF5AD770999ULL, 0x2ED0F59D6B43AC8BULL },
+	{ nullptr, 3, 0x56E6957632A487F9ULL, 0x5ACB303E78133C22ULL },
+	{ nullptr, 4, 0xC60D15B1E3FF8F04ULL, 0x7D51D5E2461732B3ULL },
+	{ nullptr, 7, 0xAFBEFC3D6C6F9A8EULL, 0x2CE9ADEC2B2C8104ULL },
+	{ nullptr, 8, 0x3DA5C7AA269683E0ULL, 0x758848F033FA76A2ULL },
+	{ nullptr, 31, 0x4A74F3A1A39AD4A1ULL, 0x8137041F5AF88413ULL },
+	{ nullptr, 32, 0x8D57D6A4671CC43DULL, 0x184EBCF3745CD46CULL },
+	{ nullptr, 33, 0x62C9FD21ED857664ULL, 0x52FAC3C981F3CC2EULL },
+	{ nullptr, 63, 0x5C320A0D2707057FULL, 0x64EF99A2E94CC7BDULL },
+	{ nullptr, 100, 0xEFA0AD2D3E70C151ULL, 0xBC7AB33BE7528C18ULL },
+	{ nullptr, 4096, 0xE21174BE82DC78D9ULL, 0xE4D8CED124DF0294ULL },
+};
+
+int main(int argc, char** argv) {
+	int columns = argc > 1 ? atoi(argv[1]) : 20000;
+
+	// Hashes end up in conversion manifests: they must be exactly XXH64, fed whole or in pieces
+	srand(1);
+	for (const KnownAnswer& a : answers) {
+		std::vector<uint8_t> input = a.text ? std::vector<uint8_t>(a.text, a.text + a.length) : pattern(a.length);
+		ContentHasher whole;
+		whole.update(input.data(), input.size());
+		ContentHash h = whole.digest();
+		ContentHasher pieces;
+		for (size_t i = 0; i < input.size();) {
+			size_t n = std::min(input.size() - i, (size_t)(rand() % 40));
+			pieces.update(input.data() + i, n);
+			i += n;
+		}
+		ContentHash p = pieces.digest();
+		if (h.lo != a.lo || h.hi != a.hi || !(p == h)) {
+			printf("wrong hash for %zu bytes: %016llx %016llx, pieces %016llx %016llx, expected %016llx %016llx\n", a.length,
+				(unsigned long long)h.lo, (unsigned long long)h.hi, (unsigned long long)p.lo, (unsigned long long)p.hi,
+				(unsigned long long)a.lo, (unsigned long long)a.hi);
+			return 1;
+		}
+	}
+	printf("%d known answers match (hash version %u)\n", (int)(sizeof(answers) / sizeof(answers[0])), CONTENT_HASH_VERSION);
+
+	std::vector<uint8_t> column = pattern(COLUMN_BLOCKS);
+	uint64_t sink = 0;
+	auto t0 = std::chrono::steady_clock::now();
+	for (int c = 0; c < columns; c++) {
+		column[c % COLUMN_BLOCKS]++;
+		ContentHasher h;
+		h.update(column.data(), column.size());
+		sink ^= h.digest().lo;
+	}
+	double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	printf("%.0f columns/s  %.1f MB/s  (checksum %llu)\n", columns / t, (double)columns * COLUMN_BLOCKS / t / (1024.0 * 1024.0),
+		(unsigned long long)sink);
+	return 0;
+}
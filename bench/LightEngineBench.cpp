@@ -0,0 +1,294 @@
+// LightEngine checked against a naive breadth-first lighter on synthetic 3x3-column neighbourhoods, then timed
+// build: g++ -O2 -std=c++11 -I.. LightEngineBench.cpp ../LightEngine.cpp ../BlockMap.cpp -o lightengine_bench
+// usage: lightengine_bench [neighbourhoods]; exits 1 on the first mismatch
+
+#include "BlockMap.h"
+#include "LightEngine.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+static const int N = 16;
+static const int HEIGHT = CHUNKS_PER_COLUMN_IN_FILE * N;
+static const int W = 3 * N; // neighbourhood width in blocks
+static const int CHUNK_BLOCKS = N * N * N;
+
+// Nine columns of Eden blocks; missing[ax][az] leaves that column out of the neighbourhood
+struct Neighbourhood {
+	std::vector<block8> blocks[3][3];
+	bool missing[3][3];
+
+	Neighbourhood() {
+		for (int ax = 0; ax < 3; ax++) {
+			for (int az = 0; az < 3; az++) {
+				blocks[ax][az].assign(CHUNKS_PER_COLUMN_IN_FILE * CHUNK_BLOCKS, 0);
+				missing[ax][az] = false;
+			}
+		}
+	}
+
+	// x, z in 0..47, y in 0..63; Eden x,z,y order inside each chunk
+	block8& at(int x, int z, int y) {
+		return blocks[x / N][z / N][(y / N) * CHUNK_BLOCKS + (x % N) * N * N + (z % N) * N + y % N];
+	}
+};
+
+// Eden ids grouped by how they treat light, taken from the converter's own tables
+struct LightIds {
+	std::vector<block8> opaque, clear, thin, dense, emitting;
+};
+
+static bool minecraftId(block8 edenId, uint8_t& id) {
+	uint8_t meta = 0;
+	id = 0;
+	return mapEdenToMinecraft(edenId, 0, id, meta);
+}
+
+static LightIds lightIds() {
+	LightIds ids;
+	for (int i = 1; i < 128; i++) {
+		uint8_t id;
+		if (!minecraftId((block8)i, id)) continue;
+		int op = minecraftLightOpacity(id);
+		if (minecraftLightEmission(id)) ids.emitting.push_back((block8)i);
+		else if (op == 15) ids.opaque.push_back((block8)i);
+		else if (op == 0) ids.clear.push_back((block8)i);
+		else if (op == 1) ids.thin.push_back((block8)i);
+		else ids.dense.push_back((block8)i);
+	}
+	return ids;
+}
+
+// The rules LightEngine implements, one block at a time: sky light comes straight down (15 above the
+// highest non-clear block, then minus the opacity, at least 1, per block), emitters start at their
+// emission, and light spreads to the six neighbours minus the neighbour's opacity (at least 1).
+// Missing columns are open air, outside the neighbourhood nothing is lit
+struct ReferenceLighter {
+	std::vector<uint8_t> opacity, light;
+
+	static int index(int x, int z, int y) { return (x * W + z) * HEIGHT + y; }
+
+	void fill(Neighbourhood& hood, bool sky) {
+		opacity.assign(W * W * HEIGHT, 0);
+		light.assign(W * W * HEIGHT, 0);
+		for (int x = 0; x < W; x++) {
+			for (int z = 0; z < W; z++) {
+				bool missing = hood.missing[x / N][z / N];
+				for (int y = 0; y < HEIGHT; y++) {
+					uint8_t id = 0;
+					if (!missing) minecraftId(hood.at(x, z, y), id);
+					opacity[index(x, z, y)] = minecraftLightOpacity(id);
+					if (!sky) light[index(x, z, y)] = minecraftLightEmission(id);
+				}
+				if (!sky) continue;
+				int level = 15;
+				for (int y = HEIGHT - 1; y >= 0 && level > 0; y--) {
+					int op = opacity[index(x, z, y)];
+					if (op || level < 15) level -= op ? op : 1;
+					if (level > 0) light[index(x, z, y)] = (uint8_t)level;
+				}
+			}
+		}
+	}
+
+	void flood() {
+		std::deque<int> queue;
+		for (int i = 0; i < (int)light.size(); i++) {
+			if (light[i] > 1) queue.push_back(i);
+		}
+		while (!queue.empty()) {
+			int i = queue.front();
+			queue.pop_front();
+			int x = i / (W * HEIGHT), z = (i / HEIGHT) % W, y = i % HEIGHT;
+			const int step[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+			for (const int* s : step) {
+				int nx = x + s[0], nz = z + s[1], ny = y + s[2];
+				if (nx < 0 || nx >= W || nz < 0 || nz >= W || ny < 0 || ny >= HEIGHT) continue;
+				int n = index(nx, nz, ny);
+				int op = opacity[n];
+				if (op >= 15) continue;
+				int to = light[i] - (op ? op : 1);
+				if (to > light[n]) {
+					light[n] = (uint8_t)to;
+					queue.push_back(n);
+				}
+			}
+		}
+	}
+
+	// Centre column only, in ColumnLight's nibble layout
+	void unpack(uint8_t out[][2048]) const {
+		for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) memset(out[cy], 0, 2048);
+		for (int lx = 0; lx < N; lx++) {
+			for (int lz = 0; lz < N; lz++) {
+				for (int y = 0; y < HEIGHT; y++) {
+					int i = ((y & 15) * N + lz) * N + lx;
+					out[y >> 4][i >> 1] |= (uint8_t)(light[index(N + lx, N + lz, y)] << (4 * (lx & 1)));
+				}
+			}
+		}
+	}
+
+	void compute(Neighbourhood& hood, ColumnLight& out) {
+		fill(hood, true);
+		flood();
+		unpack(out.sky);
+		fill(hood, false);
+		flood();
+		unpack(out.block);
+	}
+};
+
+static block8 pickFrom(const std::vector<block8>& ids, block8 otherwise) {
+	return ids.empty() ? otherwise : ids[rand() % ids.size()];
+}
+
+// Terrain with caves, water pools, floating glass and leaves and scattered emitters; every kind of
+// block at the column seams
+static void randomTerrain(Neighbourhood& hood, const LightIds& ids) {
+	int base = 8 + rand() % 40;
+	for (int x = 0; x < W; x++) {
+		for (int z = 0; z < W; z++) {
+			int height = base + rand() % 6;
+			for (int y = 0; y < HEIGHT; y++) {
+				block8 b = 0;
+				int r = rand() % 100;
+				if (y < height) {
+					if (r < 70) b = pickFrom(ids.opaque, 1);
+					else if (r < 80) b = pickFrom(ids.dense, 0);
+					else if (r < 85) b = pickFrom(ids.thin, 0);
+					else if (r < 87) b = pickFrom(ids.emitting, 0);
+					else if (r < 93) b = pickFrom(ids.clear, 0);
+				} else if (r < 3) {
+					b = pickFrom(ids.thin, 0);
+				} else if (r < 5) {
+					b = pickFrom(ids.clear, 0);
+				} else if (r < 6) {
+					b = pickFrom(ids.opaque, 1);
+				} else if (r < 7) {
+					b = pickFrom(ids.emitting, 0);
+				}
+				hood.at(x, z, y) = b;
+			}
+		}
+	}
+}
+
+// Edge cases first (open sky, a sealed box with one light inside, an overhang, a light in a
+// neighbour next to the seam, negative ids), then random terrain; each with a rotating set of
+// missing columns, always keeping the centre
+static std::vector<Neighbourhood> testNeighbourhoods(int randomCount, const LightIds& ids) {
+	std::vector<Neighbourhood> hoods;
+	block8 stone = pickFrom(ids.opaque, 1), lamp = pickFrom(ids.emitting, 0);
+
+	Neighbourhood open;
+	hoods.push_back(open);
+
+	Neighbourhood box;
+	for (int x = 0; x < W; x++)
+		for (int z = 0; z < W; z++)
+			for (int y = 0; y < HEIGHT; y++) box.at(x, z, y) = stone;
+	for (int x = 10; x < 38; x++)
+		for (int z = 10; z < 38; z++)
+			for (int y = 10; y < 50; y++) box.at(x, z, y) = 0;
+	box.at(24, 24, 30) = lamp;
+	hoods.push_back(box);
+
+	Neighbourhood overhang;
+	for (int x = 0; x < W; x++) {
+		for (int z = 0; z < W; z++) {
+			for (int y = 0; y < 20; y++) overhang.at(x, z, y) = stone;
+			if (x < 30) overhang.at(x, z, 40) = stone;
+		}
+	}
+	hoods.push_back(overhang);
+
+	Neighbourhood seam;
+	for (int x = 0; x < W; x++)
+		for (int z = 0; z < W; z++)
+			for (int y = 0; y < HEIGHT; y++) seam.at(x, z, y) = (y < 60) ? 0 : stone;
+	seam.at(N - 1, N + 3, 30) = lamp;
+	seam.at(2 * N, 2 * N - 1, 5) = lamp;
+	hoods.push_back(seam);
+
+	Neighbourhood negative;
+	for (int x = 0; x < W; x++)
+		for (int z = 0; z < W; z++)
+			for (int y = 0; y < HEIGHT; y++) negative.at(x, z, y) = (block8)(y < 32 ? -5 : 0);
+	negative.at(20, 20, 10) = lamp;
+	hoods.push_back(negative);
+
+	srand(1);
+	for (int k = 0; k < randomCount; k++) {
+		Neighbourhood h;
+		randomTerrain(h, ids);
+		hoods.push_back(h);
+	}
+	for (size_t k = 0; k < hoods.size(); k++) {
+		for (int a = 0; a < 9; a++) hoods[k].missing[a / 3][a % 3] = a != 4 && ((k * 7 + a) % 4 == 0);
+	}
+	return hoods;
+}
+
+static void views(Neighbourhood& hood, ColumnView storage[3][3], const ColumnView* out[3][3]) {
+	for (int ax = 0; ax < 3; ax++) {
+		for (int az = 0; az < 3; az++) {
+			for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) {
+				storage[ax][az].blocks[cy] = hood.blocks[ax][az].data() + cy * CHUNK_BLOCKS;
+				storage[ax][az].colors[cy] = nullptr;
+			}
+			out[ax][az] = hood.missing[ax][az] ? nullptr : &storage[ax][az];
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	int count = argc > 1 ? atoi(argv[1]) : 2000;
+
+	// The engine must match the reference nibble for nibble before timing means anything
+	LightIds ids = lightIds();
+	std::vector<Neighbourhood> hoods = testNeighbourhoods(48, ids);
+	LightEngine engine;
+	ReferenceLighter reference;
+	static ColumnLight expected, got;
+	ColumnView storage[3][3];
+	const ColumnView* hood[3][3];
+	for (size_t k = 0; k < hoods.size(); k++) {
+		views(hoods[k], storage, hood);
+		reference.compute(hoods[k], expected);
+		memset(&got, 0xAA, sizeof(got));
+		engine.compute(hood, got);
+		for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) {
+			const char* kind = memcmp(got.sky[cy], expected.sky[cy], 2048) ? "sky" : memcmp(got.block[cy], expected.block[cy], 2048) ? "block" : nullptr;
+			if (kind) {
+				printf("%s light differs from the reference in section %d of test neighbourhood %d\n", kind, cy, (int)k);
+				return 1;
+			}
+		}
+	}
+	printf("%d test neighbourhoods: sky and block light match the reference\n", (int)hoods.size());
+
+	using clock = std::chrono::steady_clock;
+	unsigned sink = 0;
+	int referenceCount = count / 20 > 0 ? count / 20 : 1;
+	auto t0 = clock::now();
+	for (int i = 0; i < referenceCount; i++) {
+		reference.compute(hoods[i % hoods.size()], expected);
+		sink += expected.sky[i & 3][i & 2047] + expected.block[i & 3][(i * 7) & 2047];
+	}
+	double tr = std::chrono::duration<double>(clock::now() - t0).count() / referenceCount;
+	t0 = clock::now();
+	for (int i = 0; i < count; i++) {
+		views(hoods[i % hoods.size()], storage, hood);
+		engine.compute(hood, got);
+		sink += got.sky[i & 3][i & 2047] + got.block[i & 3][(i * 7) & 2047];
+	}
+	double te = std::chrono::duration<double>(clock::now() - t0).count() / count;
+	printf("%-10s %10.0f columns/s\n", "reference", 1.0 / tr);
+	printf("%-10s %10.0f columns/s  %6.1fx\n", "engine", 1.0 / te, tr / te);
+	printf("(checksum %u)\n", sink);
+	return 0;
+}
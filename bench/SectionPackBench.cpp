@@ -0,0 +1,124 @@
+// Section packing kernels and sectionIsAir checked against the per-voxel mapEdenToMinecraft loop, then timed
+// build: g++ -O2 -std=c++11 -I.. SectionPackBench.cpp ../SectionPack.cpp ../BlockMap.cpp -o sectionpack_bench
+// usage: sectionpack_bench [sections]; exits 1 on the first mismatch
+
+#include "BlockMap.h"
+#include "SectionPack.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static const int N = 16;
+static const int VOXELS = N * N * N;
+
+// The original loop: Eden X,Z,Y order in, Anvil Y,Z,X order out, one lookup per voxel
+static void packReference(const int8_t* src, uint8_t* blocks, uint8_t* data) {
+	memset(data, 0, VOXELS / 2);
+	for (int x = 0; x < N; x++) {
+		for (int z = 0; z < N; z++) {
+			for (int y = 0; y < N; y++) {
+				uint8_t id = 0, meta = 0;
+				if (!mapEdenToMinecraft(src[x * N * N + z * N + y], 0, id, meta)) id = meta = 0;
+				int i = (y * N + z) * N + x;
+				blocks[i] = id;
+				data[i >> 1] |= (uint8_t)((meta & 0x0F) << ((i & 1) * 4));
+			}
+		}
+	}
+}
+
+// Edge cases first (all air, every id as a whole section, negative and out-of-range ids, patterns
+// that tell the axes apart), then random sections
+static std::vector<std::vector<int8_t>> testSections(int randomCount) {
+	std::vector<std::vector<int8_t>> sections;
+	std::vector<int8_t> s(VOXELS);
+	sections.push_back(s); // all air
+	for (int id = 0; id < 256; id++) {
+		std::fill(s.begin(), s.end(), (int8_t)id);
+		sections.push_back(s);
+	}
+	for (int i = 0; i < VOXELS; i++) s[i] = (int8_t)i; // every byte value at every position modulo 256
+	sections.push_back(s);
+	for (int i = 0; i < VOXELS; i++) s[i] = (int8_t)(i * 7 + (i >> 8)); // x, z and y all differ
+	sections.push_back(s);
+	for (int i = 0; i < VOXELS; i++) s[i] = (int8_t)-(1 + i % 128); // negative ids only
+	sections.push_back(s);
+	for (int pos : { 0, 255, 256, VOXELS / 2 + 17, VOXELS - 1 }) {
+		for (int i = 0; i < VOXELS; i++) s[i] = (int8_t)-(1 + i % 128); // air but for one block
+		s[pos] = 1;
+		sections.push_back(s);
+	}
+	for (int i = 0; i < VOXELS; i++) s[i] = (int8_t)((i & 1) ? 0 : 1); // alternating along y
+	sections.push_back(s);
+	for (int i = 0; i < VOXELS; i++) s[i] = (int8_t)(((i >> 8) & 1) ? 3 : 0); // alternating along x (nibble pairs)
+	sections.push_back(s);
+	srand(1);
+	for (int k = 0; k < randomCount; k++) {
+		bool fullRange = k & 1; // every byte, or Eden's range with plenty of air
+		for (auto& id : s) id = (int8_t)(fullRange ? rand() % 256 : ((rand() % 4 == 0) ? 0 : (rand() % 120) - 4));
+		sections.push_back(s);
+	}
+	return sections;
+}
+
+int main(int argc, char** argv) {
+	int count = argc > 1 ? atoi(argv[1]) : 20000;
+
+	// Every kernel must match the reference byte for byte before timing means anything. Input one
+	// byte off alignment, since columns come straight out of the file mapping
+	std::vector<std::vector<int8_t>> sections = testSections(64);
+	std::vector<int8_t> unaligned(VOXELS + 1);
+	uint8_t refBlocks[VOXELS], refData[VOXELS / 2], blocks[VOXELS], data[VOXELS / 2];
+	for (size_t s = 0; s < sections.size(); s++) {
+		memcpy(unaligned.data() + 1, sections[s].data(), VOXELS);
+		const int8_t* src = unaligned.data() + 1;
+		packReference(src, refBlocks, refData);
+		bool air = true;
+		for (int i = 0; i < VOXELS; i++) air = air && !refBlocks[i] && !refData[i >> 1];
+		if (sectionIsAir(src) != air) {
+			printf("sectionIsAir is %s on test section %d\n", air ? "false" : "true", (int)s);
+			return 1;
+		}
+		for (int k = PACK_SCALAR; k <= PACK_AVX2; k++) {
+			SectionPackKernel kernel = (SectionPackKernel)k;
+			if (!sectionPackKernelSupported(kernel)) continue;
+			memset(blocks, 0xAA, sizeof(blocks));
+			memset(data, 0xAA, sizeof(data));
+			packSectionWith(kernel, src, blocks, data);
+			if (memcmp(blocks, refBlocks, sizeof(blocks)) != 0 || memcmp(data, refData, sizeof(data)) != 0) {
+				printf("%s kernel differs from the reference on test section %d\n", sectionPackKernelName(kernel), (int)s);
+				return 1;
+			}
+		}
+	}
+	printf("%d test sections: sectionIsAir and every supported kernel match the reference\n", (int)sections.size());
+
+	using clock = std::chrono::steady_clock;
+	const std::vector<int8_t>& input = sections.back();
+	unsigned sink = 0;
+	auto time = [&](void (*pack)(const int8_t*, uint8_t*, uint8_t*)) {
+		auto t0 = clock::now();
+		for (int i = 0; i < count; i++) {
+			pack(input.data(), blocks, data);
+			sink += blocks[i & (VOXELS - 1)] + data[i & (VOXELS / 2 - 1)];
+		}
+		return std::chrono::duration<double>(clock::now() - t0).count();
+	};
+	double reference = time(packReference);
+	printf("%-10s %8.2f Mvoxels/s\n", "reference", (double)count * VOXELS / reference / 1e6);
+	for (int k = PACK_SCALAR; k <= PACK_AVX2; k++) {
+		SectionPackKernel kernel = (SectionPackKernel)k;
+		if (!sectionPackKernelSupported(kernel)) continue;
+		auto t0 = clock::now();
+		for (int i = 0; i < count; i++) {
+			packSectionWith(kernel, input.data(), blocks, data);
+			sink += blocks[i & (VOXELS - 1)] + data[i & (VOXELS / 2 - 1)];
+		}
+		double t = std::chrono::duration<double>(clock::now() - t0).count();
+		printf("%-10s %8.2f Mvoxels/s  %6.1fx\n", sectionPackKernelName(kernel), (double)count * VOXELS / t / 1e6, reference / t);
+	}
+	printf("(checksum %u)\n", sink);
+	return 0;
+}
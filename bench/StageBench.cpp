@@ -0,0 +1,243 @@
+// Stage benchmarks of the converter on a synthetic world: directory load, column read, block mapping,
+// section packing, NBT encoding, compression and region writes, each timed on its own
+// build: g++ -O2 -std=c++14 -I.. StageBench.cpp SyntheticWorld.cpp $(ls ../*.cpp | grep -v main.cpp) -lz -lpthread -o stage_bench
+//        (add -DEDEN_WITH_LIBDEFLATE -ldeflate and/or -DEDEN_WITH_URING -luring for those backends)
+// usage: stage_bench [-n columns per side] [-e empty fraction] [-d diversity] [-s seed] [-r repeats]
+//                    [-o world.eden] [--generate-only]
+
+#include "AnvilWriter.h"
+#include "BlockMap.h"
+#include "ColumnLookup.h"
+#include "EdenMappedFile.h"
+#include "NBT.h"
+#include "SectionPack.h"
+#include "SyntheticWorld.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static const int VOXELS = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+static const double MB = 1024.0 * 1024.0;
+
+// Best of repeats runs of fn, in seconds
+template <typename Fn>
+static double best(int repeats, Fn fn) {
+	using clock = std::chrono::steady_clock;
+	double fastest = 0;
+	for (int r = 0; r < repeats; r++) {
+		auto t0 = clock::now();
+		fn();
+		double t = std::chrono::duration<double>(clock::now() - t0).count();
+		if (r == 0 || t < fastest) fastest = t;
+	}
+	return fastest;
+}
+
+static void report(const char* stage, double seconds, double columns, double bytes) {
+	printf("%-26s %9.2f ms %12.0f columns/s %10.1f MB/s\n", stage, seconds * 1e3, columns / seconds, bytes / MB / seconds);
+}
+
+static void removeWorld(const std::string& dir) {
+	std::string regionDir = dir + "/region";
+	if (DIR* d = opendir(regionDir.c_str())) {
+		while (dirent* e = readdir(d)) {
+			if (e->d_name[0] != '.') unlink((regionDir + "/" + e->d_name).c_str());
+		}
+		closedir(d);
+	}
+	rmdir(regionDir.c_str());
+	rmdir(dir.c_str());
+}
+
+int main(int argc, char** argv) {
+	SyntheticWorldSettings settings;
+	int repeats = 3;
+	const char* worldPath = "stage_bench.eden";
+	bool generateOnly = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) settings.columnsX = settings.columnsZ = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) settings.emptyFraction = atof(argv[++i]);
+		else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) settings.diversity = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) settings.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) repeats = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) worldPath = argv[++i];
+		else if (strcmp(argv[i], "--generate-only") == 0) generateOnly = true;
+		else { printf("unknown argument: %s\n", argv[i]); return 1; }
+	}
+	if (repeats < 1) repeats = 1;
+
+	if (!writeSyntheticWorld(worldPath, settings)) return 1;
+	printf("world: %d x %d columns, %.0f%% empty, %d materials, seed %u -> %s\n", settings.columnsX, settings.columnsZ,
+		settings.emptyFraction * 100, settings.diversity, settings.seed, worldPath);
+	if (generateOnly) return 0;
+
+	EdenMappedFile file;
+	if (!file.open(worldPath)) { printf("failed to map %s\n", worldPath); return 1; }
+	unsigned long long dirOffset = file.header()->directory_offset;
+	size_t count = (size_t)((file.size() - dirOffset) / sizeof(ColumnIndex));
+	std::vector<ColumnIndex> directory(count);
+	memcpy(directory.data(), file.range(dirOffset, count * sizeof(ColumnIndex)), count * sizeof(ColumnIndex));
+	std::vector<ColumnView> views(count);
+	for (size_t i = 0; i < count; i++) file.column(directory[i], views[i]);
+	const double columnBytes = (double)count * COLUMN_BYTES_IN_FILE;
+	const double blockBytes = (double)count * CHUNKS_PER_COLUMN_IN_FILE * VOXELS;
+	unsigned long long sink = 0;
+
+	// Directory load: map the file, copy the directory and build the (x,z) lookup, as the loader does
+	double t = best(repeats, [&] {
+		EdenMappedFile f;
+		f.open(worldPath);
+		std::vector<ColumnIndex> dir(count);
+		memcpy(dir.data(), f.range(dirOffset, count * sizeof(ColumnIndex)), count * sizeof(ColumnIndex));
+		ColumnLookup lookup;
+		lookup.reset((int)count);
+		for (size_t i = 0; i < count; i++) lookup.insert(dir[i].x, dir[i].z, (int)i);
+		sink += lookup.size();
+	});
+	report("directory load", t, (double)count, (double)count * sizeof(ColumnIndex));
+
+	// Column read: every byte of every column through the mapping
+	t = best(repeats, [&] {
+		for (size_t i = 0; i < count; i++) {
+			file.column(directory[i], views[i]);
+			for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) {
+				uint64_t acc = 0, v;
+				for (int k = 0; k < VOXELS; k += 8) {
+					memcpy(&v, views[i].blocks[cy] + k, 8);
+					acc ^= v;
+					memcpy(&v, views[i].colors[cy] + k, 8);
+					acc ^= v;
+				}
+				sink += acc;
+			}
+		}
+	});
+	report("column read (mmap)", t, (double)count, columnBytes);
+
+	t = best(repeats, [&] {
+		for (size_t i = 0; i < count; i++) {
+			for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) {
+				const block8* blocks = views[i].blocks[cy];
+				for (int k = 0; k < VOXELS; k++) {
+					uint8_t id = 0, data = 0;
+					if (mapEdenToMinecraft(blocks[k], 0, id, data)) sink += id + data;
+				}
+			}
+		}
+	});
+	report("mapEdenToMinecraft", t, (double)count, blockBytes);
+
+	// Section packing with each kernel this CPU runs, skipping all-air sections like the converter
+	static ColumnSections scratch;
+	for (int k = PACK_SCALAR; k <= PACK_AVX2; k++) {
+		SectionPackKernel kernel = (SectionPackKernel)k;
+		if (!sectionPackKernelSupported(kernel)) continue;
+		t = best(repeats, [&] {
+			for (size_t i = 0; i < count; i++) {
+				for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) {
+					if (sectionIsAir(views[i].blocks[cy])) continue;
+					packSectionWith(kernel, views[i].blocks[cy], scratch.blocks[cy], scratch.data[cy]);
+				}
+				sink += scratch.blocks[0][i & 4095];
+			}
+		});
+		std::string name = std::string("section pack (") + sectionPackKernelName(kernel) + ")";
+		report(name.c_str(), t, (double)count, blockBytes);
+	}
+
+	// Packed sections and height maps of every column that has blocks, input for the stages below
+	std::vector<ColumnSections> packed;
+	std::vector<int32_t> heightMaps;
+	for (size_t i = 0; i < count; i++) {
+		ColumnSections s;
+		int present = 0;
+		const uint8_t* sectionBlocks[COLUMN_SECTIONS];
+		for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE; cy++) {
+			s.present[cy] = !sectionIsAir(views[i].blocks[cy]);
+			if (s.present[cy]) { packSection(views[i].blocks[cy], s.blocks[cy], s.data[cy]); present++; }
+			sectionBlocks[cy] = s.present[cy] ? s.blocks[cy] : nullptr;
+		}
+		if (!present) continue;
+		packed.push_back(s);
+		heightMaps.resize(packed.size() * 256);
+		buildHeightMap(sectionBlocks, COLUMN_SECTIONS, &heightMaps[(packed.size() - 1) * 256]);
+	}
+	const double encoded = (double)packed.size();
+	// chunk positions for the payloads: rows of 32 from (64,64), the synthetic world's corner
+	auto chunkX = [](size_t i) { return (int)(i % 32) + 64; };
+	auto chunkZ = [](size_t i) { return (int)(i / 32) + 64; };
+
+	// NBT encoding alone: the uncompressed backend only copies the bytes
+	CompressionSettings none;
+	none.kind = COMPRESS_NONE;
+	ChunkCompressor* raw = ChunkCompressor::create(none);
+	std::vector<std::vector<uint8_t>> nbtBodies(packed.size());
+	const ChunkFormat formats[] = { CHUNK_FORMAT_1_12, CHUNK_FORMAT_1_16 };
+	for (ChunkFormat format : formats) {
+		CompressedBody body;
+		double nbtBytes = 0;
+		t = best(repeats, [&] {
+			nbtBytes = 0;
+			for (size_t i = 0; i < packed.size(); i++) {
+				AnvilWriter::encodeBody(packed[i], &heightMaps[i * 256], nullptr, format, *raw, body);
+				nbtBytes += body.data.size();
+				if (format == CHUNK_FORMAT_1_12) nbtBodies[i] = body.data;
+			}
+		});
+		std::string name = std::string("NBT encode ") + chunkFormatName(format);
+		report(name.c_str(), t, encoded, nbtBytes);
+	}
+	delete raw;
+
+	// compressZlib on whole NBT bodies
+	double nbtTotal = 0, zlibTotal = 0;
+	t = best(repeats, [&] {
+		nbtTotal = zlibTotal = 0;
+		for (const std::vector<uint8_t>& nbt : nbtBodies) {
+			nbtTotal += nbt.size();
+			zlibTotal += nbt::compressZlib(nbt).size();
+		}
+	});
+	report("compressZlib", t, encoded, nbtTotal);
+	printf("%-26s %9.2fx\n", "  compression ratio", nbtTotal / (zlibTotal > 0 ? zlibTotal : 1));
+
+	// What the converter runs per chunk: encode with streaming deflate, then frame the payload
+	ChunkCompressor* zlib = ChunkCompressor::create(CompressionSettings());
+	std::vector<std::vector<uint8_t>> payloads(packed.size());
+	t = best(repeats, [&] {
+		for (size_t i = 0; i < packed.size(); i++) {
+			AnvilWriter::encodeChunk(chunkX(i), chunkZ(i), packed[i], &heightMaps[i * 256], nullptr, CHUNK_FORMAT_1_12, *zlib, payloads[i]);
+		}
+	});
+	report("NBT encode + zlib:1", t, encoded, nbtTotal);
+	delete zlib;
+
+	// Region writes: every payload placed and written, headers and close included
+	std::string outDir = std::string(worldPath) + ".out";
+	double written = 0;
+	t = 0;
+	for (int r = 0; r < repeats; r++) {
+		removeWorld(outDir);
+		std::vector<std::vector<uint8_t>> copies = payloads;
+		AnvilWriter writer(outDir);
+		double s = best(1, [&] {
+			for (size_t i = 0; i < copies.size(); i++) {
+				written += copies[i].size();
+				writer.writePayload(chunkX(i), chunkZ(i), std::move(copies[i]));
+			}
+			writer.close();
+		});
+		if (r == 0 || s < t) t = s;
+	}
+	report("region write", t, encoded, written / repeats);
+	removeWorld(outDir);
+
+	unlink(worldPath);
+	printf("(checksum %llu)\n", sink);
+	return 0;
+}
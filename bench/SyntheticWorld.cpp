@@ -0,0 +1,137 @@
+#include "SyntheticWorld.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const int VOXELS = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+static const int HILL = 12; // terrain height varies this much around groundHeight
+static const int COLOR_COUNT = 56;
+
+// Eden block ids (TYPE_* in Constants.h, whose T_SIZE/T_HEIGHT clash with EdenFileLoader.h)
+static const int LAST_BLOCK_ID = 111; // TYPE_BTSTEEL
+
+// Materials in the order the diversity setting adds them: common terrain first, then everything else.
+// Stone, dirt, grass, sand, dark stone, wood, tree, leaves, brick, cobblestone, water, glass, shingle,
+// stone ramp, wood side, lightbox
+static const int preferredIds[] = { 2, 3, 8, 4, 10, 7, 6, 5, 13, 14, 20, 58, 56, 24, 44, 72 };
+static const int GRASS = 2; // position of grass in preferredIds
+
+static inline uint64_t mix64(uint64_t v) {
+	v += 0x9E3779B97F4A7C15ULL;
+	v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	v = (v ^ (v >> 27)) * 0x94D049BB133111EBULL;
+	return v ^ (v >> 31);
+}
+
+static inline uint64_t hash3(uint32_t seed, int a, int b, int c) {
+	return mix64(((uint64_t)seed << 32) ^ mix64(((uint64_t)(uint32_t)a << 32 | (uint32_t)b) ^ mix64((uint64_t)(uint32_t)c)));
+}
+
+static void materialList(int diversity, std::vector<int>& out) {
+	out.clear();
+	for (int id : preferredIds) out.push_back(id);
+	for (int id = 1; id <= LAST_BLOCK_ID; id++) {
+		bool listed = false;
+		for (int p : preferredIds) listed = listed || p == id;
+		if (!listed) out.push_back(id);
+	}
+	if (diversity < 1) diversity = 1;
+	if ((size_t)diversity < out.size()) out.resize(diversity);
+}
+
+// Value noise on a 16 block grid, bilinearly interpolated: gentle hills in -HILL..HILL
+static int hillHeight(uint32_t seed, int wx, int wz) {
+	int gx = wx >> 4, gz = wz >> 4;
+	int fx = wx & 15, fz = wz & 15;
+	int c00 = (int)(hash3(seed, gx, gz, -1) % (2 * HILL + 1)) - HILL;
+	int c10 = (int)(hash3(seed, gx + 1, gz, -1) % (2 * HILL + 1)) - HILL;
+	int c01 = (int)(hash3(seed, gx, gz + 1, -1) % (2 * HILL + 1)) - HILL;
+	int c11 = (int)(hash3(seed, gx + 1, gz + 1, -1) % (2 * HILL + 1)) - HILL;
+	int top = c00 * (16 - fx) + c10 * fx;
+	int bottom = c01 * (16 - fx) + c11 * fx;
+	return (top * (16 - fz) + bottom * fz) / 256;
+}
+
+void generateColumn(const SyntheticWorldSettings& settings, int x, int z,
+	block8 blocks[CHUNKS_PER_COLUMN_IN_FILE][CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE],
+	color8 colors[CHUNKS_PER_COLUMN_IN_FILE][CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE]) {
+	memset(blocks, 0, sizeof(block8) * CHUNKS_PER_COLUMN_IN_FILE * VOXELS);
+	memset(colors, 0, sizeof(color8) * CHUNKS_PER_COLUMN_IN_FILE * VOXELS);
+	if ((hash3(settings.seed, x, z, -2) >> 11) * (1.0 / 9007199254740992.0) < settings.emptyFraction) return;
+
+	std::vector<int> materials;
+	materialList(settings.diversity, materials);
+	int count = (int)materials.size();
+	const int height = CHUNKS_PER_COLUMN_IN_FILE * CHUNK_SIZE;
+
+	for (int bx = 0; bx < CHUNK_SIZE; bx++) {
+		for (int bz = 0; bz < CHUNK_SIZE; bz++) {
+			int wx = x * CHUNK_SIZE + bx, wz = z * CHUNK_SIZE + bz;
+			int h = settings.groundHeight + hillHeight(settings.seed, wx, wz);
+			if (h < 1) h = 1;
+			if (h > height) h = height;
+			for (int y = 0; y < h; y++) {
+				// layers of one material across the world, with one block in 16 scattered
+				uint64_t r = hash3(settings.seed, wx, wz, y);
+				int m = (r & 15) == 0 ? (int)((r >> 8) % count) : (int)(hash3(settings.seed, y / 3, 0, -3) % count);
+				if (y == h - 1) m = count > GRASS ? GRASS : 0; // grass on top once there is grass
+				int i = bx * CHUNK_SIZE * CHUNK_SIZE + bz * CHUNK_SIZE + (y % CHUNK_SIZE);
+				blocks[y / CHUNK_SIZE][i] = (block8)materials[m];
+				colors[y / CHUNK_SIZE][i] = (color8)((r >> 40) % COLOR_COUNT);
+			}
+		}
+	}
+}
+
+bool writeSyntheticWorld(const char* path, const SyntheticWorldSettings& settings) {
+	FILE* f = fopen(path, "wb");
+	if (!f) { printf("failed to create %s\n", path); return false; }
+
+	std::vector<ColumnIndex> directory;
+	for (int i = 0; i < settings.columnsX; i++) {
+		for (int j = 0; j < settings.columnsZ; j++) {
+			ColumnIndex ci;
+			ci.x = settings.originX + i;
+			ci.z = settings.originZ + j;
+			ci.chunk_offset = 0;
+			directory.push_back(ci);
+		}
+	}
+	if (settings.shuffle) {
+		for (size_t i = directory.size(); i > 1; i--) {
+			size_t k = (size_t)(hash3(settings.seed, (int)i, 0, -4) % i);
+			ColumnIndex t = directory[i - 1];
+			directory[i - 1] = directory[k];
+			directory[k] = t;
+		}
+	}
+
+	WorldFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.level_seed = (int)settings.seed;
+	// player and home in the middle of the world, above the hills
+	header.pos.x = header.home.x = (float)((settings.originX + settings.columnsX / 2) * CHUNK_SIZE);
+	header.pos.y = header.home.y = (float)(settings.groundHeight + HILL + 2);
+	header.pos.z = header.home.z = (float)((settings.originZ + settings.columnsZ / 2) * CHUNK_SIZE);
+	header.version = FILE_VERSION;
+	strcpy(header.name, "Synthetic");
+	header.directory_offset = sizeof(header) + (unsigned long long)directory.size() * COLUMN_BYTES_IN_FILE;
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+	static block8 blocks[CHUNKS_PER_COLUMN_IN_FILE][VOXELS];
+	static color8 colors[CHUNKS_PER_COLUMN_IN_FILE][VOXELS];
+	unsigned long long offset = sizeof(header);
+	for (size_t i = 0; i < directory.size() && ok; i++) {
+		directory[i].chunk_offset = offset;
+		generateColumn(settings, directory[i].x, directory[i].z, blocks, colors);
+		// every chunk is its block array followed by its color array
+		for (int cy = 0; cy < CHUNKS_PER_COLUMN_IN_FILE && ok; cy++) {
+			ok = fwrite(blocks[cy], sizeof(blocks[cy]), 1, f) == 1 && fwrite(colors[cy], sizeof(colors[cy]), 1, f) == 1;
+		}
+		offset += COLUMN_BYTES_IN_FILE;
+	}
+	if (ok && !directory.empty()) ok = fwrite(directory.data(), sizeof(ColumnIndex), directory.size(), f) == directory.size();
+	ok = fclose(f) == 0 && ok;
+	if (!ok) printf("failed to write %s\n", path);
+	return ok;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "EdenFileLoader.h"
+#include <cstdint>
+
+// Deterministic synthetic .eden worlds for benchmarks: a header, every column's four chunks and the
+// column directory, laid out like a world saved by Eden. The same settings always give the same bytes
+
+struct SyntheticWorldSettings {
+	int columnsX = 32, columnsZ = 32; // world size in columns
+	int originX = 64, originZ = 64;   // column at the low x,z corner
+	double emptyFraction = 0.15;      // share of columns that are entirely air
+	int diversity = 16;               // distinct Eden block ids in the terrain (1 = one material)
+	int groundHeight = 24;            // average terrain height in blocks; hills reach 12 above or below
+	uint32_t seed = 1;
+	bool shuffle = true;              // store columns in random order instead of row by row, like an edited world
+};
+
+// Block and color arrays of column (x,z), chunk cy at [cy], in Eden's x*256+z*16+y order
+void generateColumn(const SyntheticWorldSettings& settings, int x, int z,
+	block8 blocks[CHUNKS_PER_COLUMN_IN_FILE][CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE],
+	color8 colors[CHUNKS_PER_COLUMN_IN_FILE][CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE]);
+
+// Write the whole world to path; false if the file can't be written
+bool writeSyntheticWorld(const char* path, const SyntheticWorldSettings& settings);
@@ -3,16 +3,122 @@
 #include "EdenFileLoader.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-int main()
+// usage: EdenToMC [-j threads] [-c zlib[:level]|libdeflate[:level]|none] [--safe] [--full] [--box minX,minZ,maxX,maxZ] [--radius n] [--around player|home] [--io auto|sync|threads|uring] [--max-open-regions n] [--no-light] [--no-dedup] [--format 1.12|1.16] [--profile] [--trace trace.json] [world.eden] [outputWorldDir]
+// --box is in output chunk coordinates (inclusive); --radius n converts the (2n+1) x (2n+1) chunks
+// centred on the player's (or with --around home, the home position's) chunk
+int main(int argc, char** argv)
 {
 	EdenFileLoader* efl = new EdenFileLoader();
 
 	//Remember to unzip the eden file before using this on a download from the shared world server.  (add .zip to the file name and extract it)
 
-	char worldFile[] = "FILE.eden";
+	const char* worldFile = "FILE.eden";
 	const char* outputWorld = "ConvertedWorld";
 
+	ConversionArea area;
+	ConversionAreaKind around = AREA_ALL; // AREA_ALL: --around not given
+	int radius = -1;
+	int positional = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			efl->setThreadCount(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--no-light") == 0) {
+			efl->setLighting(false);
+		}
+		else if (strcmp(argv[i], "--no-dedup") == 0) {
+			efl->setDedup(false);
+		}
+		else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+			ChunkFormat format;
+			if (!parseChunkFormat(argv[++i], format)) {
+				printf("unknown chunk format: %s\n", argv[i]);
+				return 1;
+			}
+			efl->setChunkFormat(format);
+		}
+		else if (strcmp(argv[i], "--profile") == 0) {
+			efl->setProfile(true);
+		}
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			efl->setProfile(true);
+			efl->setTracePath(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--safe") == 0) {
+			efl->setCrashSafeOutput(true);
+		}
+		else if (strcmp(argv[i], "--full") == 0) {
+			efl->setIncremental(false);
+		}
+		else if (strcmp(argv[i], "--box") == 0 && i + 1 < argc) {
+			ConversionArea a;
+			a.kind = AREA_BOX;
+			if (sscanf(argv[++i], "%d,%d,%d,%d", &a.minX, &a.minZ, &a.maxX, &a.maxZ) != 4 || a.maxX < a.minX || a.maxZ < a.minZ) {
+				printf("invalid chunk box: %s (expected minX,minZ,maxX,maxZ)\n", argv[i]);
+				return 1;
+			}
+			area = a;
+		}
+		else if (strcmp(argv[i], "--radius") == 0 && i + 1 < argc) {
+			radius = atoi(argv[++i]);
+			if (radius < 0) {
+				printf("invalid radius: %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--around") == 0 && i + 1 < argc) {
+			++i;
+			if (strcmp(argv[i], "player") == 0) around = AREA_PLAYER;
+			else if (strcmp(argv[i], "home") == 0) around = AREA_HOME;
+			else {
+				printf("unknown position: %s (expected player or home)\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--io") == 0 && i + 1 < argc) {
+			RegionIOBackend backend;
+			if (!parseRegionIOBackend(argv[++i], backend)) {
+				printf("unknown region I/O backend: %s\n", argv[i]);
+				return 1;
+			}
+			efl->setRegionIO(backend);
+		}
+		else if (strcmp(argv[i], "--max-open-regions") == 0 && i + 1 < argc) {
+			efl->setMaxOpenRegions(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+			CompressionSettings cs;
+			if (!parseCompression(argv[++i], cs)) {
+				printf("unknown compression: %s\n", argv[i]);
+				return 1;
+			}
+			efl->setCompression(cs);
+		}
+		else if (positional == 0) {
+			worldFile = argv[i];
+			positional++;
+		}
+		else {
+			outputWorld = argv[i];
+		}
+	}
+
+	if (around != AREA_ALL && radius < 0) {
+		printf("--around needs --radius\n");
+		return 1;
+	}
+	if (radius >= 0) {
+		if (area.kind == AREA_BOX) {
+			printf("--box and --radius can't be combined\n");
+			return 1;
+		}
+		area.kind = around != AREA_ALL ? around : AREA_PLAYER;
+		area.radius = radius;
+	}
+	efl->setArea(area);
+
 	printf("Hello world.\n");
 
 	efl->convertToMinecraft(worldFile, outputWorld);